@@ -0,0 +1,365 @@
+/*
+  ==============================================================================
+
+    Headless benchmark for the MIDI pipeline.
+
+    Drives StraDellaMIDIAudioProcessor the way the editor and a host do:
+    scripted key, bellows and expression streams are queued between blocks,
+    then processBlock is timed across a range of block sizes and sample rates.
+    The processor runs the built-in layout, never the user's mapping file,
+    so runs on different machines can be compared.
+
+    processBlock always runs in a real-time section of RealtimeSafetyChecker,
+    which counts the allocations per block. With --rt-check every allocation,
+    lock and blocking system call it makes is printed with a stack trace, and
+    the run fails if there were any. The check also runs with fixed latency,
+    with the retrigger policy and with a host buffer that was never reserved;
+    only the processor's own, counted growth of that buffer is allowed.
+
+    Usage: straDellaBenchmark [--quick] [--rt-check] [--scenario <name>]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "RealtimeSafetyChecker.h"
+
+#include <cstdio>
+
+//==============================================================================
+namespace
+{
+    constexpr int midiChannel = 1;
+    
+    // What the harness's "host" reserves for the plugin's output, like a real host does
+    constexpr int hostMidiBufferBytes = 64 * 1024;
+    
+    /** Plays the editor's part: key presses and releases, bellows reversals and controller targets */
+    class EventScript
+    {
+    public:
+        explicit EventScript(StraDellaMIDIAudioProcessor& processorToDrive)
+            : processor(processorToDrive)
+        {
+            for (int keyCode = 0; keyCode < StradellaKeyboardMapper::numKeyCodes; ++keyCode)
+                if (processor.getKeyboardMapper().isKeyMapped(keyCode))
+                    mappedKeys.add(keyCode);
+        }
+        
+        void pressKey(int keyCode, int velocity, juce::int64 ticks)
+        {
+            if (!processor.getKeyState().press(keyCode))
+                return;
+            
+            const auto& midiNotes = processor.getKeyboardMapper().getMidiNotesForKey(keyCode);
+            processor.setSoundingNotesForKey(keyCode, midiNotes);
+            
+            for (int noteNumber : midiNotes)
+                processor.addMidiMessageToBuffer(juce::MidiMessage::noteOn(midiChannel, noteNumber, (juce::uint8)velocity), ticks);
+        }
+        
+        void releaseKey(int keyCode, juce::int64 ticks)
+        {
+            if (!processor.getKeyState().release(keyCode))
+                return;
+            
+            for (int noteNumber : processor.takeSoundingNotesForKey(keyCode))
+                processor.addMidiMessageToBuffer(juce::MidiMessage::noteOff(midiChannel, noteNumber), ticks);
+        }
+        
+        void releaseAllKeys(juce::int64 ticks)
+        {
+            processor.getKeyState().snapshot().forEach([this, ticks](int keyCode) { releaseKey(keyCode, ticks); });
+        }
+        
+        int getMappedKey(int index) const
+        {
+            return mappedKeys.isEmpty() ? 0 : mappedKeys[index % mappedKeys.size()];
+        }
+        
+        StraDellaMIDIAudioProcessor& processor;
+    
+    private:
+        juce::Array<int> mappedKeys;
+    };
+    
+    /** A named event stream: called once before each block with the block's index */
+    struct Scenario
+    {
+        const char* name;
+        const char* description;
+        std::function<void(EventScript&, juce::int64 block, juce::int64 ticks)> queueEvents;
+    };
+    
+    const std::vector<Scenario>& getScenarios()
+    {
+        static const std::vector<Scenario> scenarios
+        {
+            { "legato", "One key change every 4 blocks, bass and chord overlapping",
+              [](EventScript& script, juce::int64 block, juce::int64 ticks)
+              {
+                  if (block % 4 != 0)
+                      return;
+                  
+                  const int step = (int)(block / 4);
+                  
+                  if (step >= 2)
+                      script.releaseKey(script.getMappedKey(step - 2), ticks);
+                  
+                  script.pressKey(script.getMappedKey(step), 100, ticks);
+              } },
+            
+            { "bellows", "Four held keys, reversal every 8 blocks, CC1/CC11 moving every block",
+              [](EventScript& script, juce::int64 block, juce::int64 ticks)
+              {
+                  for (int i = 0; i < 4; ++i)
+                      script.pressKey(script.getMappedKey(i * 5), 90, ticks);
+                  
+                  const int value = (int)(64 + 63 * std::sin((double)block * 0.05));
+                  script.processor.setControllerTarget(1, value, ticks);
+                  script.processor.setControllerTarget(11, value, ticks);
+                  
+                  if (block % 8 == 7)
+                      script.processor.reverseBellows(80 + (int)(block % 40), ticks);
+              } },
+            
+            { "burst", "Eight keys pressed and released every block",
+              [](EventScript& script, juce::int64 block, juce::int64 ticks)
+              {
+                  script.releaseAllKeys(ticks);
+                  
+                  for (int i = 0; i < 8; ++i)
+                      script.pressKey(script.getMappedKey((int)block * 3 + i * 7), 110, ticks);
+              } },
+            
+            { "overload", "One key pressed and released past the output budget every 16 blocks",
+              [](EventScript& script, juce::int64 block, juce::int64 ticks)
+              {
+                  if (block % 16 != 0)
+                      return;
+                  
+                  const int keyCode = script.getMappedKey((int)(block / 16));
+                  const int numNotes = script.processor.getKeyboardMapper().getMidiNotesForKey(keyCode).size();
+                  
+                  if (numNotes == 0)
+                      return;
+                  
+                  // Each cycle sends every note on and off: about twice the budget, within the input queue
+                  const int numCycles = juce::jmin(MidiEventFifo::capacity / (2 * numNotes),
+                                                   script.processor.getOutputEventBudget() / numNotes + 1);
+                  
+                  for (int cycle = 0; cycle < numCycles; ++cycle)
+                  {
+                      script.pressKey(keyCode, 100, ticks);
+                      script.releaseKey(keyCode, ticks);
+                  }
+              } },
+        };
+        
+        return scenarios;
+    }
+    
+    /** How the processor is configured and how the "host" treats its MIDI buffer */
+    struct HostSetup
+    {
+        const char* name;
+        const char* description;
+        bool fixedLatency;
+        NoteStateTracker::RetriggerPolicy retriggerPolicy;
+        bool reserveHostBuffer;
+    };
+    
+    /** The timing runs use the first setup only; --rt-check runs all of them */
+    const std::vector<HostSetup>& getHostSetups()
+    {
+        using Policy = NoteStateTracker::RetriggerPolicy;
+        
+        static const std::vector<HostSetup> setups
+        {
+            { "live",    "Live latency, repeated note-ons ignored, host buffer reserved", false, Policy::IgnoreRepeatedNoteOn, true },
+            { "fixed",   "Fixed latency of one block, through the jitter buffer",       true,  Policy::IgnoreRepeatedNoteOn, true },
+            { "retrig",  "Repeated note-ons re-articulate the sounding note",            false, Policy::RetriggerRepeatedNoteOn, true },
+            { "unsized", "Host MIDI buffer never reserved, so processBlock grows it",    false, Policy::IgnoreRepeatedNoteOn, false },
+        };
+        
+        return setups;
+    }
+    
+    //==============================================================================
+    struct Result
+    {
+        juce::int64 numBlocks = 0;
+        juce::int64 numMessages = 0;
+        juce::int64 numAllocations = 0;
+        juce::uint64 numThinned = 0;        // Events the output overflow policy removed
+        juce::int64 numGrowthViolations = 0; // Allocations and frees in blocks where the processor counted host buffer growth
+        double totalSeconds = 0.0;
+        double worstBlockSeconds = 0.0;
+    };
+    
+    Result runScenario(const Scenario& scenario, const HostSetup& setup, double sampleRate, int blockSize, double audioSeconds)
+    {
+        using Counter = PerformanceCounters::Counter;
+        using Violation = RealtimeSafetyChecker::Violation;
+        
+        // The built-in layout, so results don't depend on a mapping file on this machine
+        StraDellaMIDIAudioProcessor processor(false);
+        processor.setFixedLatencyMode(setup.fixedLatency);
+        processor.setRetriggerPolicy(setup.retriggerPolicy);
+        processor.prepareToPlay(sampleRate, blockSize);
+        
+        const auto& counters = processor.getPerformanceCounters();
+        EventScript script(processor);
+        juce::AudioBuffer<float> buffer(2, blockSize);
+        juce::MidiBuffer midiMessages;
+        
+        // Clearing keeps the storage, so an unreserved buffer only grows in the first blocks
+        if (setup.reserveHostBuffer)
+            midiMessages.ensureSize(hostMidiBufferBytes);
+        
+        const auto numBlocks = (juce::int64)(audioSeconds * sampleRate / blockSize);
+        Result result;
+        
+        for (juce::int64 block = 0; block < numBlocks; ++block)
+        {
+            scenario.queueEvents(script, block, juce::Time::getHighResolutionTicks());
+            
+            buffer.clear();
+            midiMessages.clear();
+            
+            const auto allocationsBefore = RealtimeSafetyChecker::getNumViolations(Violation::allocation);
+            const auto heapViolationsBefore = allocationsBefore + RealtimeSafetyChecker::getNumViolations(Violation::deallocation);
+            const auto growthsBefore = counters.get(Counter::outputBufferGrown);
+            juce::int64 startTicks, endTicks;
+            
+            {
+                RealtimeSafetyChecker::ScopedRealtimeSection realtimeSection;
+                startTicks = juce::Time::getHighResolutionTicks();
+                
+                processor.processBlock(buffer, midiMessages);
+                
+                endTicks = juce::Time::getHighResolutionTicks();
+            }
+            
+            const auto blockSeconds = juce::Time::highResolutionTicksToSeconds(endTicks - startTicks);
+            
+            result.numBlocks++;
+            result.numMessages += midiMessages.getNumEvents();
+            result.numAllocations += RealtimeSafetyChecker::getNumViolations(Violation::allocation) - allocationsBefore;
+            
+            // Growing the host's buffer is counted by the processor itself - keep it apart from other allocations
+            if (counters.get(Counter::outputBufferGrown) != growthsBefore)
+                result.numGrowthViolations += RealtimeSafetyChecker::getNumViolations(Violation::allocation)
+                                            + RealtimeSafetyChecker::getNumViolations(Violation::deallocation)
+                                            - heapViolationsBefore;
+            
+            result.totalSeconds += blockSeconds;
+            result.worstBlockSeconds = juce::jmax(result.worstBlockSeconds, blockSeconds);
+        }
+        
+        script.releaseAllKeys(juce::Time::getHighResolutionTicks());
+        processor.releaseResources();
+        
+        result.numThinned = counters.get(Counter::outputControllersCoalesced) + counters.get(Counter::outputNoteOnsDropped);
+        return result;
+    }
+    
+    void printResult(const Scenario& scenario, const HostSetup& setup, double sampleRate, int blockSize, const Result& result)
+    {
+        const double blocks = (double)juce::jmax((juce::int64)1, result.numBlocks);
+        
+        std::printf("%-8s %-8s %7.0f %6d %10lld %14.0f %12.1f %14.1f %12.3f %9llu\n",
+                    scenario.name, setup.name, sampleRate, blockSize, (long long)result.numMessages,
+                    result.totalSeconds > 0.0 ? (double)result.numMessages / result.totalSeconds : 0.0,
+                    result.totalSeconds * 1.0e9 / blocks,
+                    result.worstBlockSeconds * 1.0e9,
+                    (double)result.numAllocations / blocks,
+                    (unsigned long long)result.numThinned);
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    const juce::StringArray args(argv + 1, argc - 1);
+    const bool quick = args.contains("--quick");
+    const bool checkRealtimeSafety = args.contains("--rt-check");
+    const int scenarioArgIndex = args.indexOf("--scenario");
+    const juce::String onlyScenario = scenarioArgIndex >= 0 ? args[scenarioArgIndex + 1] : juce::String();
+    
+    RealtimeSafetyChecker::setReportingEnabled(checkRealtimeSafety);
+    
+    // Simulated audio per configuration
+    const double audioSeconds = quick ? 0.5 : 20.0;
+    
+    const double sampleRates[] = { 44100.0, 48000.0, 96000.0 };
+    const int blockSizes[] = { 32, 64, 128, 256, 512, 1024 };
+    
+    // Timing runs use one setup so they stay comparable; the safety check covers every code path
+    const auto& allSetups = getHostSetups();
+    const auto numSetups = checkRealtimeSafety ? allSetups.size() : (size_t)1;
+    
+    for (const auto& scenario : getScenarios())
+        std::printf("%-8s %s\n", scenario.name, scenario.description);
+    
+    std::printf("\n");
+    
+    for (size_t i = 0; i < numSetups; ++i)
+        std::printf("%-8s %s\n", allSetups[i].name, allSetups[i].description);
+    
+    std::printf("\n%-8s %-8s %7s %6s %10s %14s %12s %14s %12s %9s\n",
+                "scenario", "setup", "rate", "block", "messages", "messages/sec", "ns/block", "worst ns", "allocs/block", "thinned");
+    
+    bool ranAnything = false;
+    juce::int64 numGrowthViolations = 0;
+    
+    for (const auto& scenario : getScenarios())
+    {
+        if (onlyScenario.isNotEmpty() && onlyScenario != scenario.name)
+            continue;
+        
+        for (size_t i = 0; i < numSetups; ++i)
+        {
+            for (auto sampleRate : sampleRates)
+            {
+                for (auto blockSize : blockSizes)
+                {
+                    const auto result = runScenario(scenario, allSetups[i], sampleRate, blockSize, audioSeconds);
+                    numGrowthViolations += result.numGrowthViolations;
+                    printResult(scenario, allSetups[i], sampleRate, blockSize, result);
+                }
+            }
+        }
+        
+        ranAnything = true;
+    }
+    
+    if (!ranAnything)
+    {
+        std::fprintf(stderr, "Unknown scenario: %s\n", onlyScenario.toRawUTF8());
+        return 1;
+    }
+    
+    if (checkRealtimeSafety)
+    {
+        using Violation = RealtimeSafetyChecker::Violation;
+        
+        std::printf("\nReal-time safety violations in processBlock:");
+        
+        for (int i = 0; i < (int)Violation::numViolations; ++i)
+            std::printf(" %s %lld%s", RealtimeSafetyChecker::getViolationName((Violation)i),
+                        (long long)RealtimeSafetyChecker::getNumViolations((Violation)i),
+                        i + 1 < (int)Violation::numViolations ? "," : "\n");
+        
+        // Growing a buffer the host didn't reserve is reported above but expected; anything else fails
+        std::printf("Of which growing the unreserved host buffer: %lld\n", (long long)numGrowthViolations);
+        
+        if (RealtimeSafetyChecker::getTotalNumViolations() > numGrowthViolations)
+            return 1;
+    }
+    
+    return 0;
+}
@@ -0,0 +1,423 @@
+#include "RealtimeSafetyChecker.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined (__GLIBC__)
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <pthread.h>
+ #include <semaphore.h>
+ #include <sys/types.h>
+ #include <time.h>
+#endif
+
+//==============================================================================
+namespace
+{
+    thread_local int realtimeDepth = 0;
+    
+    // Set while the checker itself (or a replaced function forwarding to
+    // another one) runs, so nothing is reported twice or from a report
+    thread_local int suspendDepth = 0;
+    
+    std::atomic<bool> reportingEnabled { false };
+    std::atomic<std::int64_t> violationCounts[(int)RealtimeSafetyChecker::Violation::numViolations] {};
+    std::atomic<int> numReported { 0 };
+    
+    struct ScopedSuspension
+    {
+        ScopedSuspension() noexcept   { ++suspendDepth; }
+        ~ScopedSuspension() noexcept  { --suspendDepth; }
+    };
+    
+    inline bool isChecking() noexcept
+    {
+        return realtimeDepth > 0 && suspendDepth == 0;
+    }
+    
+    inline void check(RealtimeSafetyChecker::Violation violation, const char* functionName) noexcept
+    {
+        if (isChecking())
+            RealtimeSafetyChecker::noteViolation(violation, functionName);
+    }
+    
+    void printStackTrace() noexcept
+    {
+       #if defined (__GLIBC__)
+        void* frames[64];
+        const int numFrames = backtrace(frames, 64);
+        
+        // Skip noteViolation and check; symbols need the executable's exports (ENABLE_EXPORTS)
+        backtrace_symbols_fd(frames + 2, numFrames > 2 ? numFrames - 2 : 0, 2);
+       #else
+        std::fprintf(stderr, "    (no stack traces on this platform)\n");
+       #endif
+    }
+    
+    // Backs the aligned operator new / delete; on glibc this goes through the replaced
+    // posix_memalign and free, so callers suspend checking around it
+    void* allocateAligned(std::size_t size, std::size_t alignment) noexcept
+    {
+       #if defined (_MSC_VER)
+        return _aligned_malloc(size != 0 ? size : 1, alignment);
+       #else
+        void* memory = nullptr;
+        alignment = alignment < sizeof(void*) ? sizeof(void*) : alignment;
+        return posix_memalign(&memory, alignment, size != 0 ? size : 1) == 0 ? memory : nullptr;
+       #endif
+    }
+    
+    void freeAligned(void* memory) noexcept
+    {
+       #if defined (_MSC_VER)
+        _aligned_free(memory);
+       #else
+        std::free(memory);
+       #endif
+    }
+}
+
+//==============================================================================
+RealtimeSafetyChecker::ScopedRealtimeSection::ScopedRealtimeSection() noexcept   { ++realtimeDepth; }
+RealtimeSafetyChecker::ScopedRealtimeSection::~ScopedRealtimeSection() noexcept  { --realtimeDepth; }
+
+void RealtimeSafetyChecker::setReportingEnabled(bool shouldReport) noexcept
+{
+    reportingEnabled.store(shouldReport, std::memory_order_relaxed);
+}
+
+std::int64_t RealtimeSafetyChecker::getNumViolations(Violation violation) noexcept
+{
+    return violationCounts[(int)violation].load(std::memory_order_relaxed);
+}
+
+std::int64_t RealtimeSafetyChecker::getTotalNumViolations() noexcept
+{
+    std::int64_t total = 0;
+    
+    for (auto& count : violationCounts)
+        total += count.load(std::memory_order_relaxed);
+    
+    return total;
+}
+
+const char* RealtimeSafetyChecker::getViolationName(Violation violation) noexcept
+{
+    switch (violation)
+    {
+        case Violation::allocation:     return "allocation";
+        case Violation::deallocation:   return "deallocation";
+        case Violation::mutexLock:      return "mutex lock";
+        case Violation::systemCall:     return "system call";
+        case Violation::numViolations:  break;
+    }
+    
+    return "";
+}
+
+void RealtimeSafetyChecker::noteViolation(Violation violation, const char* functionName) noexcept
+{
+    ScopedSuspension suspension;
+    
+    violationCounts[(int)violation].fetch_add(1, std::memory_order_relaxed);
+    
+    if (!reportingEnabled.load(std::memory_order_relaxed))
+        return;
+    
+    const int reportIndex = numReported.fetch_add(1, std::memory_order_relaxed);
+    
+    if (reportIndex < maxReportedViolations)
+    {
+        std::fprintf(stderr, "\nReal-time safety violation: %s (%s)\n", getViolationName(violation), functionName);
+        std::fflush(stderr);
+        printStackTrace();
+    }
+    else if (reportIndex == maxReportedViolations)
+    {
+        std::fprintf(stderr, "\nFurther real-time safety violations are counted but not printed\n");
+    }
+}
+
+//==============================================================================
+// C++ allocation, on every platform. On glibc the malloc family below sees
+// the same calls, so it is suspended while these forward to it.
+using Violation = RealtimeSafetyChecker::Violation;
+
+void* operator new(std::size_t size)
+{
+    check(Violation::allocation, "operator new");
+    
+    ScopedSuspension suspension;
+    
+    if (auto* memory = std::malloc(size != 0 ? size : 1))
+        return memory;
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    check(Violation::allocation, "operator new[]");
+    
+    ScopedSuspension suspension;
+    
+    if (auto* memory = std::malloc(size != 0 ? size : 1))
+        return memory;
+    
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    if (memory == nullptr)
+        return;
+    
+    check(Violation::deallocation, "operator delete");
+    
+    ScopedSuspension suspension;
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    if (memory == nullptr)
+        return;
+    
+    check(Violation::deallocation, "operator delete[]");
+    
+    ScopedSuspension suspension;
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept    { operator delete(memory); }
+void operator delete[](void* memory, std::size_t) noexcept  { operator delete[](memory); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    check(Violation::allocation, "operator new (nothrow)");
+    
+    ScopedSuspension suspension;
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    check(Violation::allocation, "operator new[] (nothrow)");
+    
+    ScopedSuspension suspension;
+    return std::malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept     { operator delete(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept   { operator delete[](memory); }
+
+// Over-aligned types (alignas beyond the default new alignment)
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    check(Violation::allocation, "operator new (aligned)");
+    
+    ScopedSuspension suspension;
+    
+    if (auto* memory = allocateAligned(size, (std::size_t)alignment))
+        return memory;
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    check(Violation::allocation, "operator new[] (aligned)");
+    
+    ScopedSuspension suspension;
+    
+    if (auto* memory = allocateAligned(size, (std::size_t)alignment))
+        return memory;
+    
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    check(Violation::allocation, "operator new (aligned, nothrow)");
+    
+    ScopedSuspension suspension;
+    return allocateAligned(size, (std::size_t)alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    check(Violation::allocation, "operator new[] (aligned, nothrow)");
+    
+    ScopedSuspension suspension;
+    return allocateAligned(size, (std::size_t)alignment);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+    if (memory == nullptr)
+        return;
+    
+    check(Violation::deallocation, "operator delete (aligned)");
+    
+    ScopedSuspension suspension;
+    freeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+    if (memory == nullptr)
+        return;
+    
+    check(Violation::deallocation, "operator delete[] (aligned)");
+    
+    ScopedSuspension suspension;
+    freeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t alignment) noexcept                  { operator delete(memory, alignment); }
+void operator delete[](void* memory, std::size_t, std::align_val_t alignment) noexcept                { operator delete[](memory, alignment); }
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept        { operator delete(memory, alignment); }
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept      { operator delete[](memory, alignment); }
+
+//==============================================================================
+#if defined (__GLIBC__)
+
+// glibc's own entry points, which a replacement malloc may forward to
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void* __libc_valloc(size_t);
+    void __libc_free(void*);
+    
+    void* memalign(size_t, size_t) noexcept;    // <malloc.h> isn't included
+    void* valloc(size_t) noexcept;
+}
+
+extern "C" void* malloc(size_t size) noexcept
+{
+    check(Violation::allocation, "malloc");
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t numElements, size_t elementSize) noexcept
+{
+    check(Violation::allocation, "calloc");
+    return __libc_calloc(numElements, elementSize);
+}
+
+extern "C" void* realloc(void* memory, size_t size) noexcept
+{
+    check(Violation::allocation, "realloc");
+    return __libc_realloc(memory, size);
+}
+
+extern "C" void free(void* memory) noexcept
+{
+    if (memory != nullptr)
+        check(Violation::deallocation, "free");
+    
+    __libc_free(memory);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) noexcept
+{
+    check(Violation::allocation, "memalign");
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    check(Violation::allocation, "aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** memory, size_t alignment, size_t size) noexcept
+{
+    check(Violation::allocation, "posix_memalign");
+    
+    // The alignment must be a power of two multiple of sizeof (void*)
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0 || alignment == 0)
+        return EINVAL;
+    
+    if (auto* allocated = __libc_memalign(alignment, size))
+    {
+        *memory = allocated;
+        return 0;
+    }
+    
+    return ENOMEM;
+}
+
+extern "C" void* valloc(size_t size) noexcept
+{
+    check(Violation::allocation, "valloc");
+    return __libc_valloc(size);
+}
+
+//==============================================================================
+// Everything else forwards to the next definition in link order. <unistd.h>
+// and <fcntl.h> are left out on purpose: with _FORTIFY_SOURCE they turn some
+// of these into inline wrappers that can't be redefined.
+namespace
+{
+    template <typename Function>
+    Function* getNextFunction(const char* name) noexcept
+    {
+        ScopedSuspension suspension;
+        return reinterpret_cast<Function*>(dlsym(RTLD_NEXT, name));
+    }
+}
+
+#define STRADELLA_RT_FORWARD(name, violation, returnType, parameters, arguments) \
+    extern "C" returnType name parameters \
+    { \
+        static auto* next = getNextFunction<returnType parameters>(#name); \
+        check(violation, #name); \
+        return next arguments; \
+    }
+
+extern "C"
+{
+    ssize_t read(int, void*, size_t);
+    ssize_t write(int, const void*, size_t);
+    int close(int);
+    int usleep(useconds_t);
+}
+
+STRADELLA_RT_FORWARD (pthread_mutex_lock,     Violation::mutexLock,  int, (pthread_mutex_t* mutex) noexcept,                          (mutex))
+STRADELLA_RT_FORWARD (pthread_rwlock_rdlock,  Violation::mutexLock,  int, (pthread_rwlock_t* lock) noexcept,                          (lock))
+STRADELLA_RT_FORWARD (pthread_rwlock_wrlock,  Violation::mutexLock,  int, (pthread_rwlock_t* lock) noexcept,                          (lock))
+STRADELLA_RT_FORWARD (pthread_cond_wait,      Violation::mutexLock,  int, (pthread_cond_t* condition, pthread_mutex_t* mutex),        (condition, mutex))
+STRADELLA_RT_FORWARD (sem_wait,               Violation::mutexLock,  int, (sem_t* semaphore),                                         (semaphore))
+STRADELLA_RT_FORWARD (read,                   Violation::systemCall, ssize_t, (int fd, void* buffer, size_t size),                    (fd, buffer, size))
+STRADELLA_RT_FORWARD (write,                  Violation::systemCall, ssize_t, (int fd, const void* buffer, size_t size),              (fd, buffer, size))
+STRADELLA_RT_FORWARD (close,                  Violation::systemCall, int, (int fd),                                                   (fd))
+STRADELLA_RT_FORWARD (nanosleep,              Violation::systemCall, int, (const struct timespec* duration, struct timespec* remaining), (duration, remaining))
+STRADELLA_RT_FORWARD (usleep,                 Violation::systemCall, int, (useconds_t microseconds),                                  (microseconds))
+
+#undef STRADELLA_RT_FORWARD
+
+// open is variadic: the mode is only passed when a file may be created, but
+// reading it regardless is harmless on every ABI glibc supports
+extern "C" int open(const char* path, int flags, ...)
+{
+    static auto* next = getNextFunction<int (const char*, int, ...)>("open");
+    check(Violation::systemCall, "open");
+    
+    std::va_list args;
+    va_start(args, flags);
+    const auto mode = va_arg(args, unsigned int);
+    va_end(args);
+    
+    return next(path, flags, mode);
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+  ==============================================================================
+
+    Real-time safety checker for the headless harness.
+
+    Code run inside a ScopedRealtimeSection must not allocate, free, lock a
+    mutex or make a blocking system call. The checker replaces the functions
+    that do so for the whole executable; calls made inside a section are
+    counted and, when reporting is on, printed to stderr with a stack trace.
+
+    Coverage depends on the platform:
+    - everywhere: operator new / delete, including the nothrow, sized and
+      aligned (std::align_val_t) overloads
+    - glibc (Linux): malloc, calloc, realloc, free, memalign, aligned_alloc,
+      posix_memalign and valloc; pthread mutex, rwlock and condition waits,
+      sem_wait; open, read, write, close, nanosleep and usleep
+    
+    Elsewhere the C allocation functions are not seen, so a real-time path
+    that calls malloc directly is only caught on Linux.
+
+    The header doesn't include JuceHeader.h: the implementation has to stay
+    clear of the system headers whose functions it replaces.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <cstdint>
+
+//==============================================================================
+class RealtimeSafetyChecker
+{
+public:
+    enum class Violation
+    {
+        allocation,
+        deallocation,
+        mutexLock,
+        systemCall,
+        numViolations
+    };
+    
+    /** Marks the calling thread as real-time until destroyed (sections can nest) */
+    class ScopedRealtimeSection
+    {
+    public:
+        ScopedRealtimeSection() noexcept;
+        ~ScopedRealtimeSection() noexcept;
+        
+        ScopedRealtimeSection(const ScopedRealtimeSection&) = delete;
+        ScopedRealtimeSection& operator=(const ScopedRealtimeSection&) = delete;
+    };
+    
+    /** Prints each violation with a stack trace, up to maxReportedViolations of them */
+    static void setReportingEnabled(bool shouldReport) noexcept;
+    
+    static std::int64_t getNumViolations(Violation violation) noexcept;
+    static std::int64_t getTotalNumViolations() noexcept;
+    
+    static const char* getViolationName(Violation violation) noexcept;
+    
+    /** Called by the replaced functions when the calling thread is in a section */
+    static void noteViolation(Violation violation, const char* functionName) noexcept;
+    
+    static constexpr int maxReportedViolations = 20;
+
+private:
+    RealtimeSafetyChecker() = delete;
+};
@@ -0,0 +1,124 @@
+#include "ControllerEnvelopeGenerator.h"
+
+//==============================================================================
+void ControllerEnvelopeGenerator::prepare(double newSampleRate) noexcept
+{
+    sampleRate = newSampleRate;
+    blockStartSample = 0;
+    
+    for (auto& slot : slots)
+    {
+        const auto handledSequence = slot.targetSequence.load(std::memory_order_acquire);
+        slot.envelope = {};
+        slot.envelope.handledSequence = handledSequence;
+        slot.envelope.handledValueChanges = slot.valueChangeCount.load(std::memory_order_relaxed);
+    }
+}
+
+bool ControllerEnvelopeGenerator::setTarget(int controllerNumber, int value, juce::int64 timestampTicks) noexcept
+{
+    for (size_t i = 0; i < (size_t)numControllers; ++i)
+    {
+        if (controllerNumbers[i] == controllerNumber)
+        {
+            auto& slot = slots[i];
+            value = juce::jlimit(0, 127, value);
+            
+            // Targets are refreshed on every movement sample; only a new value can be lost
+            if (value != slot.lastTargetValue)
+            {
+                slot.valueChangeCount.fetch_add(1, std::memory_order_relaxed);
+                slot.lastTargetValue = value;
+            }
+            
+            // Value and time first, then the sequence that tells the audio thread to read them
+            slot.targetValue.store(value, std::memory_order_relaxed);
+            slot.targetTicks.store(timestampTicks, std::memory_order_relaxed);
+            slot.targetSequence.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+void ControllerEnvelopeGenerator::setDecay(double delaySeconds, double durationSeconds) noexcept
+{
+    decayDelaySeconds.store((float)juce::jmax(0.0, delaySeconds), std::memory_order_relaxed);
+    decayDurationSeconds.store((float)juce::jmax(0.0, durationSeconds), std::memory_order_relaxed);
+}
+
+void ControllerEnvelopeGenerator::setMaxValuesPerBlock(int newMaxValues) noexcept
+{
+    maxValuesPerBlock.store(juce::jlimit(1, maxValuesPerBlockLimit, newMaxValues), std::memory_order_relaxed);
+}
+
+void ControllerEnvelopeGenerator::startRamp(Envelope& envelope, int targetValue, int targetOffset) noexcept
+{
+    // Glide from wherever the envelope is now (possibly mid-decay) to the target's position
+    envelope.rampStartValue = envelope.value;
+    envelope.rampTargetValue = targetValue;
+    envelope.rampStartSample = blockStartSample;
+    envelope.rampEndSample = blockStartSample + targetOffset;
+}
+
+void ControllerEnvelopeGenerator::renderBlock(Envelope& envelope, juce::MidiBuffer& output,
+                                              int controllerNumber, int numSamples) noexcept
+{
+    const auto decayDelaySamples = (juce::int64)(decayDelaySeconds.load(std::memory_order_relaxed) * sampleRate);
+    const auto decayDurationSamples = (juce::int64)(decayDurationSeconds.load(std::memory_order_relaxed) * sampleRate);
+    
+    const int numPoints = juce::jmin(getMaxValuesPerBlock(), numSamples);
+    const juce::uint8 status = (juce::uint8)(0xb0 | (midiChannel - 1));
+    
+    // A target reached inside this block is sent at its own sample, not at the next grid point
+    const auto targetOffset = envelope.rampEndSample - blockStartSample;
+    bool isTargetPlaced = targetOffset < 0 || targetOffset >= numSamples;
+    
+    // Grid points sit at the end of each sub-block, so the last one covers the whole block
+    for (int point = 1; point <= numPoints; ++point)
+    {
+        int sampleOffset = (int)((juce::int64)numSamples * point / numPoints) - 1;
+        
+        if (!isTargetPlaced && sampleOffset >= targetOffset)
+        {
+            sampleOffset = (int)targetOffset;
+            isTargetPlaced = true;
+        }
+        
+        envelope.value = getValueAt(envelope, blockStartSample + sampleOffset, decayDelaySamples, decayDurationSamples);
+        const int value = juce::jlimit(0, 127, juce::roundToInt(envelope.value));
+        
+        if (value != envelope.lastEmittedValue)
+        {
+            const juce::uint8 data[] = { status, (juce::uint8)controllerNumber, (juce::uint8)value };
+            output.addEvent(data, 3, sampleOffset);
+            envelope.lastEmittedValue = value;
+        }
+    }
+}
+
+double ControllerEnvelopeGenerator::getValueAt(const Envelope& envelope, juce::int64 sample,
+                                               juce::int64 decayDelaySamples, juce::int64 decayDurationSamples) const noexcept
+{
+    // Glide to the target
+    if (sample < envelope.rampEndSample)
+    {
+        const auto progress = (double)(sample - envelope.rampStartSample)
+                            / (double)(envelope.rampEndSample - envelope.rampStartSample);
+        
+        return envelope.rampStartValue + (envelope.rampTargetValue - envelope.rampStartValue) * progress;
+    }
+    
+    // Hold it while the bellows keep moving (or shortly after they stop)
+    const auto decayStartSample = envelope.rampEndSample + decayDelaySamples;
+    
+    if (sample < decayStartSample)
+        return envelope.rampTargetValue;
+    
+    // Then fall linearly to zero
+    if (sample < decayStartSample + decayDurationSamples)
+        return envelope.rampTargetValue * (1.0 - (double)(sample - decayStartSample) / (double)decayDurationSamples);
+    
+    return 0.0;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Generates the expression controller streams (CC1 and CC11) in processBlock.
+    
+    The expression side only publishes target values, refreshing them for as long
+    as the bellows are moving. Each block the generator glides from the current
+    value to the latest target at the target's own sample position, holds it, and
+    once no target has arrived for the decay delay, ramps down to zero over the
+    decay time - all on the audio clock, so it keeps running when the editor's
+    threads are starved.
+    
+    Values are evaluated on a sub-block grid of at most maxValuesPerBlock points
+    and only sent when they change. The grid point that reaches a target is moved
+    to the target's own sample, so even one value per block lands where the
+    target was captured.
+*/
+class ControllerEnvelopeGenerator
+{
+public:
+    static constexpr int midiChannel = 1;
+    static constexpr int numControllers = 2;
+    static constexpr std::array<int, numControllers> controllerNumbers { 1, 11 };   // Modulation, Expression
+    
+    static constexpr int maxValuesPerBlockLimit = 16;
+    
+    //==============================================================================
+    ControllerEnvelopeGenerator() = default;
+    
+    /** Resets every envelope to zero. Not while the audio thread runs. */
+    void prepare(double sampleRate) noexcept;
+    
+    /** Publishes the latest value for a controller (any single producer thread).
+        Returns false if the controller is not generated here and should be sent as a normal event.
+    */
+    bool setTarget(int controllerNumber, int value, juce::int64 timestampTicks) noexcept;
+    
+    /** Sets how long a target is held after the last update, and how long it then takes to fall to zero */
+    void setDecay(double delaySeconds, double durationSeconds) noexcept;
+    
+    /** Sets the sub-block resolution: how many values per controller a block may carry */
+    void setMaxValuesPerBlock(int newMaxValues) noexcept;
+    int getMaxValuesPerBlock() const noexcept { return maxValuesPerBlock.load(std::memory_order_relaxed); }
+    
+    /** Emits the controller values for one block. getSampleOffset maps a capture time in
+        high-resolution ticks to a sample offset from this block's start, which may lie in a
+        later block (fixed-latency mode delays targets like every other event). Audio thread only.
+        Returns how many target values were replaced by a different one before a block used
+        them. Refreshes that repeat the current value don't count.
+    */
+    template <typename OffsetFunction>
+    juce::uint32 process(juce::MidiBuffer& output, int numSamples, OffsetFunction&& getSampleOffset) noexcept
+    {
+        juce::uint32 numSupersededTargets = 0;
+        
+        if (numSamples <= 0)
+            return numSupersededTargets;
+        
+        for (size_t i = 0; i < (size_t)numControllers; ++i)
+        {
+            auto& slot = slots[i];
+            const auto sequence = slot.targetSequence.load(std::memory_order_acquire);
+            
+            if (sequence != slot.envelope.handledSequence)
+            {
+                // Every value change but the latest one was overwritten without being rendered
+                const auto valueChanges = slot.valueChangeCount.load(std::memory_order_relaxed);
+                const auto numNewValues = valueChanges - slot.envelope.handledValueChanges;
+                
+                if (numNewValues > 1)
+                    numSupersededTargets += numNewValues - 1;
+                
+                slot.envelope.handledSequence = sequence;
+                slot.envelope.handledValueChanges = valueChanges;
+                
+                const auto targetOffset = getSampleOffset(slot.targetTicks.load(std::memory_order_relaxed));
+                startRamp(slot.envelope, slot.targetValue.load(std::memory_order_relaxed), targetOffset);
+            }
+            
+            renderBlock(slot.envelope, output, controllerNumbers[i], numSamples);
+        }
+        
+        blockStartSample += numSamples;
+        return numSupersededTargets;
+    }
+
+private:
+    /** Audio thread state of one controller, in running-clock samples */
+    struct Envelope
+    {
+        juce::uint32 handledSequence = 0;
+        juce::uint32 handledValueChanges = 0;
+        double value = 0.0;                 // Value at the last evaluated grid point
+        double rampStartValue = 0.0;
+        int rampTargetValue = 0;
+        juce::int64 rampStartSample = 0;
+        juce::int64 rampEndSample = 0;      // Also where the decay delay starts counting
+        int lastEmittedValue = 0;
+    };
+    
+    struct Slot
+    {
+        std::atomic<juce::uint32> targetSequence { 0 };
+        std::atomic<int> targetValue { 0 };
+        std::atomic<juce::int64> targetTicks { 0 };
+        std::atomic<juce::uint32> valueChangeCount { 0 };  // Targets that differed from the one before
+        int lastTargetValue = 0;                            // Producer only
+        Envelope envelope;
+    };
+    
+    std::array<Slot, numControllers> slots;
+    
+    std::atomic<int> maxValuesPerBlock { 1 };
+    std::atomic<float> decayDelaySeconds { 0.1f };
+    std::atomic<float> decayDurationSeconds { 0.2f };
+    
+    double sampleRate = 44100.0;
+    juce::int64 blockStartSample = 0;
+    
+    void startRamp(Envelope& envelope, int targetValue, int targetOffset) noexcept;
+    void renderBlock(Envelope& envelope, juce::MidiBuffer& output, int controllerNumber, int numSamples) noexcept;
+    double getValueAt(const Envelope& envelope, juce::int64 sample, juce::int64 decayDelaySamples,
+                      juce::int64 decayDurationSamples) const noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ControllerEnvelopeGenerator)
+};
@@ -0,0 +1,60 @@
+#include "GuiFrameScheduler.h"
+
+//==============================================================================
+GuiFrameScheduler::GuiFrameScheduler(juce::Component& hostComponent, const KeyStateSet& keyStateToShow,
+                                     MidiCaptureQueue& emittedEventsToShow, KeyboardGUI& keyboard, MIDIMessageDisplay& display,
+                                     PerformanceCounters& countersToUpdate)
+    : keyState(keyStateToShow),
+      emittedEvents(emittedEventsToShow),
+      keyboardGUI(keyboard),
+      midiDisplay(display),
+      performanceCounters(countersToUpdate),
+      vBlankAttachment(&hostComponent, [this] { update(); })
+{
+}
+
+GuiFrameScheduler::~GuiFrameScheduler()
+{
+}
+
+//==============================================================================
+void GuiFrameScheduler::update()
+{
+    countSkippedFrames();
+    
+    // Key highlights: one diff of the held-key set, repainting only the keys that changed
+    const auto heldKeys = keyState.snapshot();
+    
+    if (heldKeys.words != displayedKeys.words)
+    {
+        keyboardGUI.setPressedKeys(heldKeys);
+        displayedKeys = heldKeys;
+    }
+    
+    // Log appends, in the order the host received them
+    emittedEvents.drain([this](const MidiCaptureQueue::Event& event)
+    {
+        midiDisplay.addEmittedEvent(event);
+    });
+    
+    midiDisplay.setNumDroppedEvents(emittedEvents.getNumDroppedEvents());
+    midiDisplay.flushPendingUpdates();
+}
+
+void GuiFrameScheduler::countSkippedFrames()
+{
+    const auto nowMillis = juce::Time::getMillisecondCounterHiRes();
+    const auto intervalMillis = nowMillis - lastFrameMillis;
+    lastFrameMillis = nowMillis;
+    
+    // Ignore the first frame, pauses while hidden, and back-to-back callbacks faster than any display
+    if (intervalMillis < 2.0 || intervalMillis > 1000.0)
+        return;
+    
+    if (framePeriodMillis <= 0.0 || intervalMillis < framePeriodMillis)
+        framePeriodMillis = intervalMillis;
+    
+    if (intervalMillis > framePeriodMillis * 1.5)
+        performanceCounters.add(PerformanceCounters::Counter::guiFramesSkipped,
+                                (juce::uint64)juce::roundToInt(intervalMillis / framePeriodMillis) - 1);
+}
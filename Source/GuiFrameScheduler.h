@@ -0,0 +1,53 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "KeyStateSet.h"
+#include "KeyboardGUI.h"
+#include "MIDIMessageDisplay.h"
+#include "MidiCaptureQueue.h"
+#include "PerformanceCounters.h"
+
+//==============================================================================
+/**
+    Applies all pending GUI changes once per display frame.
+    
+    Producers never post to the message queue. Key highlights come straight
+    from the processor's key-state set, diffed against what is on screen, and
+    the MIDI log shows what processBlock emitted, read from the processor's
+    capture queue. On every vblank the scheduler updates the keyboard and
+    appends to the log in a single pass, so a fast passage costs one repaint
+    per frame rather than one callAsync per event.
+    
+    Gaps between vblanks longer than the display's frame period are counted
+    as skipped frames.
+*/
+class GuiFrameScheduler
+{
+public:
+    /** Consumes emittedEvents for as long as it exists (there must be only one consumer) */
+    GuiFrameScheduler(juce::Component& hostComponent, const KeyStateSet& keyStateToShow,
+                      MidiCaptureQueue& emittedEventsToShow, KeyboardGUI& keyboard, MIDIMessageDisplay& display,
+                      PerformanceCounters& countersToUpdate);
+    ~GuiFrameScheduler();
+    
+    /** Applies everything that changed since the last frame (message thread) */
+    void update();
+
+private:
+    const KeyStateSet& keyState;
+    MidiCaptureQueue& emittedEvents;
+    KeyboardGUI& keyboardGUI;
+    MIDIMessageDisplay& midiDisplay;
+    PerformanceCounters& performanceCounters;
+    
+    KeyStateSet::Snapshot displayedKeys;
+    
+    void countSkippedFrames();
+    
+    double lastFrameMillis = 0.0;
+    double framePeriodMillis = 0.0;  // Shortest interval seen, i.e. the display's refresh period
+    
+    juce::VBlankAttachment vBlankAttachment;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GuiFrameScheduler)
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The set of held computer keys, as 256 bits in four atomic words.
+    
+    Press, release and query are a single atomic operation on one word, so any
+    thread can read the set while the message thread updates it. snapshot()
+    copies the whole set for iteration or for diffing against another state.
+*/
+class KeyStateSet
+{
+public:
+    static constexpr int numKeyCodes = 256;
+    static constexpr int numWords = numKeyCodes / 64;
+    
+    /** A plain copy of the set at one moment */
+    struct Snapshot
+    {
+        std::array<juce::uint64, numWords> words {};
+        
+        bool contains(int keyCode) const noexcept
+        {
+            return juce::isPositiveAndBelow(keyCode, numKeyCodes)
+                && (words[(size_t)(keyCode / 64)] & getBit(keyCode)) != 0;
+        }
+        
+        void add(int keyCode) noexcept
+        {
+            if (juce::isPositiveAndBelow(keyCode, numKeyCodes))
+                words[(size_t)(keyCode / 64)] |= getBit(keyCode);
+        }
+        
+        bool isEmpty() const noexcept
+        {
+            for (auto word : words)
+                if (word != 0)
+                    return false;
+            
+            return true;
+        }
+        
+        /** Keys in this snapshot that are not in the other one */
+        Snapshot without(const Snapshot& other) const noexcept
+        {
+            Snapshot result;
+            
+            for (size_t i = 0; i < words.size(); ++i)
+                result.words[i] = words[i] & ~other.words[i];
+            
+            return result;
+        }
+        
+        /** Calls callback(keyCode) for every key in the set, in ascending order */
+        template <typename Callback>
+        void forEach(Callback&& callback) const
+        {
+            for (int wordIndex = 0; wordIndex < numWords; ++wordIndex)
+            {
+                auto word = words[(size_t)wordIndex];
+                
+                for (int bit = 0; word != 0; ++bit, word >>= 1)
+                    if ((word & 1) != 0)
+                        callback(wordIndex * 64 + bit);
+            }
+        }
+    };
+    
+    //==============================================================================
+    KeyStateSet() = default;
+    
+    /** Marks a key as held. Returns false if it already was (e.g. OS key repeat) or is out of range. */
+    bool press(int keyCode) noexcept
+    {
+        if (!juce::isPositiveAndBelow(keyCode, numKeyCodes))
+            return false;
+        
+        const auto bit = getBit(keyCode);
+        return (words[(size_t)(keyCode / 64)].fetch_or(bit, std::memory_order_acq_rel) & bit) == 0;
+    }
+    
+    /** Marks a key as released. Returns false if it wasn't held. */
+    bool release(int keyCode) noexcept
+    {
+        if (!juce::isPositiveAndBelow(keyCode, numKeyCodes))
+            return false;
+        
+        const auto bit = getBit(keyCode);
+        return (words[(size_t)(keyCode / 64)].fetch_and(~bit, std::memory_order_acq_rel) & bit) != 0;
+    }
+    
+    bool isPressed(int keyCode) const noexcept
+    {
+        return juce::isPositiveAndBelow(keyCode, numKeyCodes)
+            && (words[(size_t)(keyCode / 64)].load(std::memory_order_acquire) & getBit(keyCode)) != 0;
+    }
+    
+    /** Copies the set. Each word is read atomically. */
+    Snapshot snapshot() const noexcept
+    {
+        Snapshot result;
+        
+        for (size_t i = 0; i < words.size(); ++i)
+            result.words[i] = words[i].load(std::memory_order_acquire);
+        
+        return result;
+    }
+    
+    void clear() noexcept
+    {
+        for (auto& word : words)
+            word.store(0, std::memory_order_release);
+    }
+
+private:
+    std::array<std::atomic<juce::uint64>, numWords> words {};
+    
+    static constexpr juce::uint64 getBit(int keyCode) noexcept { return (juce::uint64)1 << (keyCode % 64); }
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (KeyStateSet)
+};
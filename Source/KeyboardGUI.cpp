@@ -16,8 +16,6 @@ void KeyboardGUI::setupKeyLayout()
 {
     keys.clear();
     
-    const float keyWidth = 50.0f;
-    const float keyHeight = 50.0f;
     const float spacing = 5.0f;
     const float rowSpacing = 10.0f;
     
@@ -88,73 +86,164 @@ void KeyboardGUI::setupKeyLayout()
         key.bounds = juce::Rectangle<float>(startX + i * (keyWidth + spacing), currentY, keyWidth, keyHeight);
         keys.add(key);
     }
+    
+    keyIndexForCode.fill(-1);
+    
+    for (int i = 0; i < keys.size(); ++i)
+    {
+        auto& key = keys.getReference(i);
+        updateKeyLabel(key);
+        
+        if (juce::isPositiveAndBelow(key.keyCode, StradellaKeyboardMapper::numKeyCodes))
+            keyIndexForCode[(size_t)key.keyCode] = i;
+    }
+}
+
+void KeyboardGUI::updateKeyLabel(KeyButton& key)
+{
+    key.labelGlyphs.clear();
+    key.labelGlyphs.addFittedText(juce::Font(16.0f), key.label,
+                                  key.bounds.getX(), key.bounds.getY(), key.bounds.getWidth(), key.bounds.getHeight(),
+                                  juce::Justification::centred, 1);
+}
+
+void KeyboardGUI::setKeyState(KeyButton& key, bool isPressed)
+{
+    if (key.isPressed != isPressed)
+    {
+        key.isPressed = isPressed;
+        repaint(key.bounds.getSmallestIntegerContainer());
+    }
 }
 
 void KeyboardGUI::setKeyPressed(int keyCode, bool isPressed)
 {
-    for (auto& key : keys)
+    if (juce::isPositiveAndBelow(keyCode, StradellaKeyboardMapper::numKeyCodes))
     {
-        if (key.keyCode == keyCode)
-        {
-            key.isPressed = isPressed;
-            repaint();
-            break;
-        }
+        const int index = keyIndexForCode[(size_t)keyCode];
+        
+        if (index >= 0)
+            setKeyState(keys.getReference(index), isPressed);
     }
 }
 
+void KeyboardGUI::setPressedKeys(const KeyStateSet::Snapshot& pressedKeys)
+{
+    for (auto& key : keys)
+        setKeyState(key, pressedKeys.contains(key.keyCode));
+}
+
 bool KeyboardGUI::isKeyPressed(int keyCode) const
 {
-    for (const auto& key : keys)
+    if (juce::isPositiveAndBelow(keyCode, StradellaKeyboardMapper::numKeyCodes))
     {
-        if (key.keyCode == keyCode)
-            return key.isPressed;
+        const int index = keyIndexForCode[(size_t)keyCode];
+        
+        if (index >= 0)
+            return keys[index].isPressed;
     }
+    
     return false;
 }
 
+void KeyboardGUI::refreshKeyMappings()
+{
+    for (auto& key : keys)
+    {
+        key.label = keyMapper.getKeyDescription(key.keyCode);
+        key.type = keyMapper.getKeyType(key.keyCode);
+        updateKeyLabel(key);
+    }
+    
+    repaint();
+}
+
 void KeyboardGUI::paint(juce::Graphics& g)
 {
-    // Background
-    g.fillAll(juce::Colours::darkgrey.darker());
+    const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    
+    if (scale != cachedScale || backgroundImage.isNull())
+        renderCachedImages(scale);
+    
+    // Background and row captions
+    g.drawImage(backgroundImage, getLocalBounds().toFloat());
+    
+    // Draw only the keys inside the area being repainted
+    const auto clip = g.getClipBounds().toFloat();
     
-    // Draw all keys
     for (const auto& key : keys)
     {
-        drawKey(g, key);
+        if (key.bounds.intersects(clip))
+            drawKey(g, key);
     }
-    
-    // Draw labels for key rows
-    g.setColour(juce::Colours::white);
-    g.setFont(12.0f);
-    g.drawText("Minor Chords:", 10, 30, 70, 20, juce::Justification::centredRight);
-    g.drawText("Major Chords:", 10, 90, 70, 20, juce::Justification::centredRight);
-    g.drawText("Single Notes:", 10, 150, 70, 20, juce::Justification::centredRight);
-    g.drawText("Third Notes:", 10, 210, 70, 20, juce::Justification::centredRight);
 }
 
 void KeyboardGUI::resized()
 {
-    // Keys are laid out in setupKeyLayout()
+    // Keys are laid out in setupKeyLayout(); the background is rendered at the new size
+    backgroundImage = {};
 }
 
-void KeyboardGUI::drawKey(juce::Graphics& g, const KeyButton& key)
+void KeyboardGUI::renderCachedImages(float scale)
 {
-    // Get color based on key type and state
-    juce::Colour keyColour = getColourForKeyType(key.type, key.isPressed);
+    cachedScale = scale;
+    
+    {
+        backgroundImage = juce::Image(juce::Image::ARGB,
+                                      juce::jmax(1, juce::roundToInt((float)getWidth() * scale)),
+                                      juce::jmax(1, juce::roundToInt((float)getHeight() * scale)), true);
+        juce::Graphics g(backgroundImage);
+        g.addTransform(juce::AffineTransform::scale(scale));
+        
+        g.fillAll(juce::Colours::darkgrey.darker());
+        
+        // Draw labels for key rows
+        g.setColour(juce::Colours::white);
+        g.setFont(12.0f);
+        g.drawText("Minor Chords:", 10, 30, 70, 20, juce::Justification::centredRight);
+        g.drawText("Major Chords:", 10, 90, 70, 20, juce::Justification::centredRight);
+        g.drawText("Single Notes:", 10, 150, 70, 20, juce::Justification::centredRight);
+        g.drawText("Third Notes:", 10, 210, 70, 20, juce::Justification::centredRight);
+    }
     
-    // Draw key background
-    g.setColour(keyColour);
-    g.fillRoundedRectangle(key.bounds, 5.0f);
+    // One face per key type and state: the rounded body and its border, without the label
+    const auto faceBounds = juce::Rectangle<float>(keyWidth, keyHeight).reduced(1.0f);
     
-    // Draw key border
-    g.setColour(juce::Colours::black);
-    g.drawRoundedRectangle(key.bounds, 5.0f, 2.0f);
+    for (int typeIndex = 0; typeIndex < numKeyTypes; ++typeIndex)
+    {
+        for (int pressed = 0; pressed < 2; ++pressed)
+        {
+            auto& image = keyFaceImages[(size_t)(typeIndex * 2 + pressed)];
+            image = juce::Image(juce::Image::ARGB,
+                                juce::roundToInt(keyWidth * scale), juce::roundToInt(keyHeight * scale), true);
+            juce::Graphics g(image);
+            g.addTransform(juce::AffineTransform::scale(scale));
+            
+            const auto type = (StradellaKeyboardMapper::KeyType)typeIndex;
+            
+            g.setColour(getColourForKeyType(type, pressed != 0));
+            g.fillRoundedRectangle(faceBounds, 5.0f);
+            
+            g.setColour(juce::Colours::black);
+            g.drawRoundedRectangle(faceBounds, 5.0f, 2.0f);
+        }
+    }
+}
+
+const juce::Image& KeyboardGUI::getKeyFaceImage(StradellaKeyboardMapper::KeyType type, bool isPressed) const
+{
+    const int typeIndex = juce::jlimit(0, numKeyTypes - 1, (int)type);
+    return keyFaceImages[(size_t)(typeIndex * 2 + (isPressed ? 1 : 0))];
+}
+
+void KeyboardGUI::drawKey(juce::Graphics& g, const KeyButton& key)
+{
+    // Key background and border from the cached face for this type and state
+    g.drawImage(getKeyFaceImage(key.type, key.isPressed), key.bounds);
     
     // Draw key label
     g.setColour(key.isPressed ? juce::Colours::white : juce::Colours::lightgrey);
-    g.setFont(16.0f);
-    g.drawText(key.label, key.bounds, juce::Justification::centred);
+    key.labelGlyphs.draw(g);
 }
 
 juce::Colour KeyboardGUI::getColourForKeyType(StradellaKeyboardMapper::KeyType type, bool isPressed) const
@@ -175,6 +264,12 @@ juce::Colour KeyboardGUI::getColourForKeyType(StradellaKeyboardMapper::KeyType t
         case StradellaKeyboardMapper::KeyType::MinorChord:
             baseColour = juce::Colours::orange;
             break;
+        case StradellaKeyboardMapper::KeyType::Dominant7Chord:
+            baseColour = juce::Colours::purple;
+            break;
+        case StradellaKeyboardMapper::KeyType::DiminishedChord:
+            baseColour = juce::Colours::red;
+            break;
         default:
             baseColour = juce::Colours::grey;
             break;
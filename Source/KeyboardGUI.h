@@ -2,10 +2,15 @@
 
 #include <JuceHeader.h>
 #include "StradellaKeyboardMapper.h"
+#include "KeyStateSet.h"
 
 //==============================================================================
 /**
     Visual representation of a computer keyboard with color feedback for key presses.
+    
+    The background with its row captions and each (key type, pressed) key face are
+    rendered once into images, and key labels are kept as glyph arrangements, so a
+    key change only repaints that key's bounds by blitting cached images.
 */
 class KeyboardGUI : public juce::Component
 {
@@ -16,9 +21,15 @@ public:
     /** Sets a key as pressed (will show in different color) */
     void setKeyPressed(int keyCode, bool isPressed);
     
+    /** Shows exactly the given keys as pressed, repainting only the keys that changed */
+    void setPressedKeys(const KeyStateSet::Snapshot& pressedKeys);
+    
     /** Checks if a key is currently pressed */
     bool isKeyPressed(int keyCode) const;
     
+    /** Re-reads labels and key types from the mapper (after a reload or transpose) */
+    void refreshKeyMappings();
+    
     void paint(juce::Graphics& g) override;
     void resized() override;
 
@@ -28,15 +39,32 @@ private:
         juce::Rectangle<float> bounds;
         int keyCode;
         juce::String label;
+        juce::GlyphArrangement labelGlyphs;
         bool isPressed;
         StradellaKeyboardMapper::KeyType type;
     };
     
+    static constexpr float keyWidth = 50.0f;
+    static constexpr float keyHeight = 50.0f;
+    static constexpr int numKeyTypes = (int)StradellaKeyboardMapper::KeyType::DiminishedChord + 1;
+    
     StradellaKeyboardMapper& keyMapper;
     juce::Array<KeyButton> keys;
     
+    // Index into keys for each key code, -1 for keys that aren't shown
+    std::array<int, StradellaKeyboardMapper::numKeyCodes> keyIndexForCode;
+    
+    // Rendered at cachedScale physical pixels per logical pixel; rebuilt when it changes
+    juce::Image backgroundImage;
+    std::array<juce::Image, (size_t)numKeyTypes * 2> keyFaceImages;
+    float cachedScale = 0.0f;
+    
     void setupKeyLayout();
+    void updateKeyLabel(KeyButton& key);
+    void renderCachedImages(float scale);
     void drawKey(juce::Graphics& g, const KeyButton& key);
+    void setKeyState(KeyButton& key, bool isPressed);
+    const juce::Image& getKeyFaceImage(StradellaKeyboardMapper::KeyType type, bool isPressed) const;
     juce::Colour getColourForKeyType(StradellaKeyboardMapper::KeyType type, bool isPressed) const;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (KeyboardGUI)
@@ -0,0 +1,277 @@
+#include "KeyboardLayoutFile.h"
+
+//==============================================================================
+namespace
+{
+    bool isSpace(char c) noexcept      { return c == ' ' || c == '\t' || c == '\r'; }
+    bool isDigit(char c) noexcept      { return c >= '0' && c <= '9'; }
+    
+    static_assert(std::is_trivially_copyable<StradellaKeyboardMapper::CompiledLayout>::value,
+                  "The compiled layout is cached as a raw binary image");
+}
+
+//==============================================================================
+bool KeyboardLayoutFile::parse(const juce::File& textFile, const CompiledLayout& fallbackTypes,
+                               CompiledLayout& result, juce::String& errorMessage)
+{
+    juce::MemoryMappedFile mappedText(textFile, juce::MemoryMappedFile::readOnly);
+    
+    if (mappedText.getData() == nullptr)
+    {
+        // Empty files can't be mapped on every platform
+        if (textFile.existsAsFile() && textFile.getSize() == 0)
+            return parse(nullptr, 0, fallbackTypes, result, errorMessage);
+        
+        errorMessage = "could not open file";
+        return false;
+    }
+    
+    return parse(static_cast<const char*>(mappedText.getData()), mappedText.getSize(),
+                 fallbackTypes, result, errorMessage);
+}
+
+bool KeyboardLayoutFile::parse(const char* text, size_t numBytes, const CompiledLayout& fallbackTypes,
+                               CompiledLayout& result, juce::String& errorMessage)
+{
+    using KeyType = StradellaKeyboardMapper::KeyType;
+    
+    result = {};
+    
+    const char* pos = text;
+    const char* const end = text + numBytes;
+    int lineNumber = 0;
+    
+    auto fail = [&errorMessage, &lineNumber](const char* reason)
+    {
+        errorMessage = "line " + juce::String(lineNumber) + ": " + reason;
+        return false;
+    };
+    
+    auto skipSpaces = [&pos, end]
+    {
+        while (pos < end && isSpace(*pos))
+            ++pos;
+    };
+    
+    // Single streaming pass - one line at a time, no intermediate strings
+    while (pos < end)
+    {
+        ++lineNumber;
+        skipSpaces();
+        
+        // Blank line or comment line
+        if (pos == end || *pos == '\n' || *pos == '#')
+        {
+            while (pos < end && *pos++ != '\n') {}
+            continue;
+        }
+        
+        // Key character (letters are stored upper case, as reported by juce::KeyPress)
+        int keyCode = (unsigned char)*pos++;
+        
+        if (keyCode >= 'a' && keyCode <= 'z')
+            keyCode = keyCode - 'a' + 'A';
+        
+        skipSpaces();
+        
+        if (pos == end || *pos != '=')
+            return fail("expected '=' after key");
+        
+        ++pos;
+        
+        // Comma-separated note numbers
+        StradellaKeyboardMapper::NoteList notes;
+        
+        for (;;)
+        {
+            skipSpaces();
+            
+            if (pos == end || !isDigit(*pos))
+                return fail("expected a MIDI note number");
+            
+            int note = 0;
+            
+            while (pos < end && isDigit(*pos))
+            {
+                note = note * 10 + (*pos++ - '0');
+                
+                if (note > 127)
+                    return fail("MIDI note number out of range (0-127)");
+            }
+            
+            if (notes.numNotes >= StradellaKeyboardMapper::maxNotesPerKey)
+                return fail("too many notes for one key");
+            
+            notes.notes[(size_t)notes.numNotes++] = (juce::uint8)note;
+            
+            skipSpaces();
+            
+            if (pos < end && *pos == ',')
+            {
+                ++pos;
+                continue;
+            }
+            
+            break;
+        }
+        
+        // Optional trailing comment, then end of line
+        if (pos < end && *pos == '#')
+            while (pos < end && *pos != '\n')
+                ++pos;
+        
+        if (pos < end && *pos != '\n')
+            return fail("unexpected characters after note list");
+        
+        if (pos < end)
+            ++pos;
+        
+        auto& entry = result.keys[(size_t)keyCode];
+        entry.midiNotes = notes;
+        
+        const auto fallbackType = fallbackTypes.keys[(size_t)keyCode].type;
+        
+        if (notes.numNotes == 1)
+            entry.type = (fallbackType == KeyType::ThirdNote) ? KeyType::ThirdNote : KeyType::SingleNote;
+        else
+            entry.type = classifyChord(notes, fallbackType);
+    }
+    
+    return true;
+}
+
+StradellaKeyboardMapper::KeyType KeyboardLayoutFile::classifyChord(const StradellaKeyboardMapper::NoteList& notes,
+                                                                   StradellaKeyboardMapper::KeyType fallback) noexcept
+{
+    using KeyType = StradellaKeyboardMapper::KeyType;
+    
+    // Which intervals above the root the chord contains
+    bool hasInterval[12] = {};
+    
+    for (int i = 1; i < notes.numNotes; ++i)
+        hasInterval[((notes[i] - notes[0]) % 12 + 12) % 12] = true;
+    
+    // Seventh and diminished chords use the reduced voicings of StradellaLayout
+    if (hasInterval[4] && hasInterval[10])
+        return KeyType::Dominant7Chord;
+    
+    if (hasInterval[3] && (hasInterval[9] || hasInterval[6]) && !hasInterval[7])
+        return KeyType::DiminishedChord;
+    
+    if (hasInterval[4])
+        return KeyType::MajorChord;
+    
+    if (hasInterval[3])
+        return KeyType::MinorChord;
+    
+    return (fallback == KeyType::SingleNote || fallback == KeyType::ThirdNote) ? KeyType::MajorChord : fallback;
+}
+
+//==============================================================================
+juce::File KeyboardLayoutFile::getCompiledImageFile(const juce::File& textFile)
+{
+    // One image per source path, kept out of the (possibly read-only) source folder
+    const auto pathHash = juce::String::toHexString(textFile.getFullPathName().hashCode64());
+    
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("straDellaMIDI")
+               .getChildFile("LayoutCache")
+               .getChildFile(textFile.getFileNameWithoutExtension() + "-" + pathHash + ".skmc");
+}
+
+KeyboardLayoutFile::ImageHeader KeyboardLayoutFile::createHeader(const juce::File& textFile, const CompiledLayout& layout)
+{
+    ImageHeader header {};
+    std::memcpy(header.magic, "SKMC", 4);
+    header.formatVersion = currentFormatVersion;
+    header.payloadSize = (juce::uint32)sizeof(CompiledLayout);
+    header.payloadChecksum = calculateChecksum(&layout, sizeof(CompiledLayout));
+    header.sourceFileSize = textFile.getSize();
+    header.sourceModificationTime = textFile.getLastModificationTime().toMilliseconds();
+    return header;
+}
+
+bool KeyboardLayoutFile::writeCompiledImage(const juce::File& imageFile, const juce::File& textFile,
+                                            const CompiledLayout& layout)
+{
+    if (!imageFile.getParentDirectory().createDirectory().wasOk())
+        return false;
+    
+    const auto header = createHeader(textFile, layout);
+    
+    juce::MemoryBlock image;
+    image.append(&header, sizeof(header));
+    image.append(&layout, sizeof(layout));
+    
+    // replaceWithData writes to a temporary file first, so readers never see a half-written image
+    return imageFile.replaceWithData(image.getData(), image.getSize());
+}
+
+bool KeyboardLayoutFile::loadCompiledImage(const juce::File& imageFile, const juce::File& textFile,
+                                           CompiledLayout& result)
+{
+    if (!imageFile.existsAsFile())
+        return false;
+    
+    juce::MemoryMappedFile mappedImage(imageFile, juce::MemoryMappedFile::readOnly);
+    
+    if (mappedImage.getData() == nullptr || mappedImage.getSize() != sizeof(ImageHeader) + sizeof(CompiledLayout))
+        return false;
+    
+    ImageHeader header;
+    std::memcpy(&header, mappedImage.getData(), sizeof(header));
+    const auto* payload = static_cast<const char*>(mappedImage.getData()) + sizeof(ImageHeader);
+    
+    if (std::memcmp(header.magic, "SKMC", 4) != 0
+        || header.formatVersion != currentFormatVersion
+        || header.payloadSize != (juce::uint32)sizeof(CompiledLayout)
+        || header.sourceFileSize != textFile.getSize()
+        || header.sourceModificationTime != textFile.getLastModificationTime().toMilliseconds()
+        || header.payloadChecksum != calculateChecksum(payload, sizeof(CompiledLayout)))
+        return false;
+    
+    // The checksum only proves the image is what was written - check it's usable too
+    CompiledLayout layout;
+    std::memcpy(&layout, payload, sizeof(CompiledLayout));
+    
+    if (!isValidLayout(layout))
+        return false;
+    
+    result = layout;
+    return true;
+}
+
+bool KeyboardLayoutFile::isValidLayout(const CompiledLayout& layout) noexcept
+{
+    using KeyType = StradellaKeyboardMapper::KeyType;
+    
+    for (const auto& entry : layout.keys)
+    {
+        if (!juce::isPositiveAndNotGreaterThan(entry.midiNotes.numNotes, StradellaKeyboardMapper::maxNotesPerKey))
+            return false;
+        
+        for (auto note : entry.midiNotes)
+            if (note > 127)
+                return false;
+        
+        if (!juce::isPositiveAndNotGreaterThan((int)entry.type, (int)KeyType::DiminishedChord))
+            return false;
+    }
+    
+    return true;
+}
+
+juce::uint32 KeyboardLayoutFile::calculateChecksum(const void* data, size_t numBytes) noexcept
+{
+    // FNV-1a (32-bit)
+    juce::uint32 hash = 2166136261u;
+    const auto* bytes = static_cast<const juce::uint8*>(data);
+    
+    for (size_t i = 0; i < numBytes; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
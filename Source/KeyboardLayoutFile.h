@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "StradellaKeyboardMapper.h"
+
+//==============================================================================
+/**
+    Reads keyboard mapping text files and caches the compiled result.
+    
+    Text format (see default_keyboard_mapping.txt):
+        # comment
+        key_character = midi_note[,midi_note...]   # optional trailing comment
+    
+    The compiled image is the raw CompiledLayout behind a small header holding
+    a format version, the source file's size and modification time, and a
+    checksum of the payload. Loading an image memory-maps it and validates all
+    of these, as well as every key's note count, note numbers and type, so a
+    stale or corrupt cache simply falls back to parsing.
+*/
+class KeyboardLayoutFile
+{
+public:
+    using CompiledLayout = StradellaKeyboardMapper::CompiledLayout;
+    
+    /** Parses a mapping file. Keys not mentioned in the file are unmapped.
+        Single-note keys take their row (type) from fallbackTypes; chord types
+        are derived from their intervals.
+    */
+    static bool parse(const juce::File& textFile, const CompiledLayout& fallbackTypes,
+                      CompiledLayout& result, juce::String& errorMessage);
+    
+    /** Parses mapping text held in memory */
+    static bool parse(const char* text, size_t numBytes, const CompiledLayout& fallbackTypes,
+                      CompiledLayout& result, juce::String& errorMessage);
+    
+    /** Where the compiled image for a given text file is cached */
+    static juce::File getCompiledImageFile(const juce::File& textFile);
+    
+    /** Writes a checksummed binary image of the layout compiled from textFile */
+    static bool writeCompiledImage(const juce::File& imageFile, const juce::File& textFile,
+                                   const CompiledLayout& layout);
+    
+    /** Memory-maps and validates an image. Fails if it is missing, corrupt or older than textFile. */
+    static bool loadCompiledImage(const juce::File& imageFile, const juce::File& textFile,
+                                  CompiledLayout& result);
+
+private:
+    struct ImageHeader
+    {
+        char magic[4];
+        juce::uint32 formatVersion;
+        juce::uint32 payloadSize;
+        juce::uint32 payloadChecksum;
+        juce::int64 sourceFileSize;
+        juce::int64 sourceModificationTime;
+    };
+    
+    static constexpr juce::uint32 currentFormatVersion = 2;  // 2: seventh and diminished key types
+    
+    static ImageHeader createHeader(const juce::File& textFile, const CompiledLayout& layout);
+    static juce::uint32 calculateChecksum(const void* data, size_t numBytes) noexcept;
+    static bool isValidLayout(const CompiledLayout& layout) noexcept;
+    static StradellaKeyboardMapper::KeyType classifyChord(const StradellaKeyboardMapper::NoteList& notes,
+                                                          StradellaKeyboardMapper::KeyType fallback) noexcept;
+};
@@ -0,0 +1,95 @@
+#include "LatencyOverlay.h"
+
+//==============================================================================
+LatencyOverlay::LatencyOverlay(const LatencyStats& statsToShow)
+    : stats(statsToShow)
+{
+    setInterceptsMouseClicks(false, false);
+    setSize(330, 150);
+}
+
+LatencyOverlay::~LatencyOverlay()
+{
+    stopTimer();
+}
+
+void LatencyOverlay::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colours::black.withAlpha(0.85f));
+    
+    g.setColour(juce::Colours::darkgrey);
+    g.drawRect(getLocalBounds(), 1);
+    
+    auto area = getLocalBounds().reduced(6);
+    
+    g.setColour(juce::Colours::white);
+    g.setFont(juce::Font(13.0f, juce::Font::bold));
+    g.drawText("Key-to-host latency (ms)", area.removeFromTop(20), juce::Justification::centredLeft);
+    
+    g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+    
+    const int rowHeight = 16;
+    auto drawRow = [&g, &area, rowHeight](const juce::String& name, const juce::String& count, const juce::String& p50,
+                                          const juce::String& p99, const juce::String& max)
+    {
+        auto row = area.removeFromTop(rowHeight);
+        g.drawText(name, row.removeFromLeft(120), juce::Justification::centredLeft);
+        g.drawText(count, row.removeFromLeft(50), juce::Justification::centredRight);
+        g.drawText(p50, row.removeFromLeft(50), juce::Justification::centredRight);
+        g.drawText(p99, row.removeFromLeft(50), juce::Justification::centredRight);
+        g.drawText(max, row.removeFromLeft(50), juce::Justification::centredRight);
+    };
+    
+    auto toMilliseconds = [](juce::int64 microseconds) { return juce::String((double)microseconds / 1000.0, 2); };
+    
+    g.setColour(juce::Colours::grey);
+    drawRow("Stage", "count", "p50", "p99", "max");
+    
+    g.setColour(juce::Colours::lightgreen);
+    
+    for (int i = 0; i < LatencyStats::numStages; ++i)
+    {
+        const auto stage = (LatencyStats::Stage)i;
+        const auto& histogram = stats.getHistogram(stage);
+        
+        drawRow(LatencyStats::getStageName(stage), juce::String(histogram.getCount()),
+                toMilliseconds(histogram.getPercentileMicroseconds(0.5)),
+                toMilliseconds(histogram.getPercentileMicroseconds(0.99)),
+                toMilliseconds(histogram.getMaxMicroseconds()));
+    }
+}
+
+void LatencyOverlay::visibilityChanged()
+{
+    // No polling while hidden
+    if (isVisible())
+    {
+        repaint();
+        startTimerHz(refreshRateHz);
+    }
+    else
+    {
+        stopTimer();
+    }
+}
+
+juce::uint64 LatencyOverlay::getTotalMeasurements() const noexcept
+{
+    juce::uint64 total = 0;
+    
+    for (int i = 0; i < LatencyStats::numStages; ++i)
+        total += stats.getHistogram((LatencyStats::Stage)i).getCount();
+    
+    return total;
+}
+
+void LatencyOverlay::timerCallback()
+{
+    const auto total = getTotalMeasurements();
+    
+    if (total != shownMeasurements)
+    {
+        shownMeasurements = total;
+        repaint();
+    }
+}
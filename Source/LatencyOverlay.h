@@ -0,0 +1,32 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LatencyStats.h"
+
+//==============================================================================
+/**
+    Shows the processor's per-stage latency histograms (count, p50, p99, max)
+    as a small table next to the MIDI log. Refreshes a few times a second while
+    visible, and only repaints when new measurements arrived.
+*/
+class LatencyOverlay : public juce::Component,
+                       private juce::Timer
+{
+public:
+    explicit LatencyOverlay(const LatencyStats& statsToShow);
+    ~LatencyOverlay() override;
+    
+    void paint(juce::Graphics& g) override;
+    void visibilityChanged() override;
+
+private:
+    const LatencyStats& stats;
+    juce::uint64 shownMeasurements = 0;
+    
+    static constexpr int refreshRateHz = 4;
+    
+    juce::uint64 getTotalMeasurements() const noexcept;
+    void timerCallback() override;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyOverlay)
+};
@@ -0,0 +1,153 @@
+#include "LatencyStats.h"
+#include "TraceLogger.h"
+
+//==============================================================================
+void LatencyHistogram::record(juce::int64 microseconds) noexcept
+{
+    microseconds = juce::jmax((juce::int64)0, microseconds);
+    
+    buckets[(size_t)getBucketIndex(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    
+    auto previousMax = maxMicroseconds.load(std::memory_order_relaxed);
+    
+    while (microseconds > previousMax
+           && !maxMicroseconds.compare_exchange_weak(previousMax, microseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+juce::int64 LatencyHistogram::getPercentileMicroseconds(double fraction) const noexcept
+{
+    // Read the buckets once so the total and the walk agree
+    std::array<juce::uint32, numBuckets> counts;
+    juce::uint64 total = 0;
+    
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    
+    if (total == 0)
+        return 0;
+    
+    const auto rank = (juce::uint64)std::ceil(juce::jlimit(0.0, 1.0, fraction) * (double)total);
+    juce::uint64 seen = 0;
+    
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        seen += counts[(size_t)i];
+        
+        if (seen >= juce::jmax((juce::uint64)1, rank))
+            return juce::jmin(getBucketUpperBound(i), getMaxMicroseconds());
+    }
+    
+    return getMaxMicroseconds();
+}
+
+void LatencyHistogram::reset() noexcept
+{
+    for (auto& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    
+    count.store(0, std::memory_order_relaxed);
+    maxMicroseconds.store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::getBucketIndex(juce::int64 microseconds) noexcept
+{
+    if (microseconds < numLinearBuckets)
+        return (int)microseconds;
+    
+    // Octave of the highest set bit (5 for 32..63), then the next three bits pick the sub-bucket
+    int octave = 0;
+    
+    for (auto value = (juce::uint64)microseconds; value > 1; value >>= 1)
+        ++octave;
+    
+    const int subBucket = (int)((microseconds >> (octave - 3)) & (subBucketsPerOctave - 1));
+    return juce::jmin(numBuckets - 1, numLinearBuckets + (octave - 5) * subBucketsPerOctave + subBucket);
+}
+
+juce::int64 LatencyHistogram::getBucketUpperBound(int index) noexcept
+{
+    if (index < numLinearBuckets)
+        return index;
+    
+    const int octave = 5 + (index - numLinearBuckets) / subBucketsPerOctave;
+    const int subBucket = (index - numLinearBuckets) % subBucketsPerOctave;
+    const auto bucketWidth = (juce::int64)1 << (octave - 3);
+    
+    return ((juce::int64)1 << octave) + (subBucket + 1) * bucketWidth - 1;
+}
+
+//==============================================================================
+void LatencyStats::recordTicks(Stage stage, juce::int64 ticks) noexcept
+{
+    recordMicroseconds(stage, (juce::int64)(juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e6));
+}
+
+void LatencyStats::recordMicroseconds(Stage stage, juce::int64 microseconds) noexcept
+{
+    histograms[(size_t)stage].record(microseconds);
+}
+
+void LatencyStats::reset() noexcept
+{
+    for (auto& histogram : histograms)
+        histogram.reset();
+}
+
+juce::String LatencyStats::createReport() const
+{
+    auto toMilliseconds = [](juce::int64 microseconds) { return juce::String((double)microseconds / 1000.0, 2); };
+    
+    juce::String report;
+    report << juce::String("Stage").paddedRight(' ', 18) << juce::String("count").paddedLeft(' ', 9)
+           << juce::String("p50 ms").paddedLeft(' ', 9) << juce::String("p99 ms").paddedLeft(' ', 9)
+           << juce::String("max ms").paddedLeft(' ', 9) << juce::newLine;
+    
+    for (int i = 0; i < numStages; ++i)
+    {
+        const auto stage = (Stage)i;
+        const auto& histogram = getHistogram(stage);
+        
+        report << getStageName(stage).paddedRight(' ', 18)
+               << juce::String(histogram.getCount()).paddedLeft(' ', 9)
+               << toMilliseconds(histogram.getPercentileMicroseconds(0.5)).paddedLeft(' ', 9)
+               << toMilliseconds(histogram.getPercentileMicroseconds(0.99)).paddedLeft(' ', 9)
+               << toMilliseconds(histogram.getMaxMicroseconds()).paddedLeft(' ', 9) << juce::newLine;
+    }
+    
+    return report;
+}
+
+juce::File LatencyStats::writeReportFile() const
+{
+    const auto now = juce::Time::getCurrentTime();
+    const auto file = TraceLogger::getLogFile().getSiblingFile("latency-" + now.formatted("%Y%m%d-%H%M%S") + ".txt");
+    
+    file.getParentDirectory().createDirectory();
+    
+    if (!file.replaceWithText("straDellaMIDI key-to-host latency, " + now.toString(true, true) + juce::newLine
+                              + juce::newLine + createReport()))
+        return {};
+    
+    return file;
+}
+
+juce::String LatencyStats::getStageName(Stage stage)
+{
+    switch (stage)
+    {
+        case Stage::keyToLookup:        return "Key -> lookup";
+        case Stage::lookupToEnqueue:    return "Lookup -> queued";
+        case Stage::queueWait:          return "Queue wait";
+        case Stage::blockOffset:        return "Block offset";
+        case Stage::keyToOutput:        return "Key -> output";
+        case Stage::numStages:          break;
+    }
+    
+    return {};
+}
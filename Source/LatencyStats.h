@@ -0,0 +1,95 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Lock-free histogram of latencies in microseconds.
+    
+    Buckets are exact below 32 us and then split each power of two into eight,
+    so percentiles are within 12.5% up to about two minutes. Recording is a few
+    relaxed atomic operations and never allocates, so any thread - including the
+    audio thread - can record while another reads.
+*/
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() = default;
+    
+    /** Adds one measurement. Negative values count as zero. Any thread. */
+    void record(juce::int64 microseconds) noexcept;
+    
+    /** Approximate value below which the given fraction (0..1) of measurements fall */
+    juce::int64 getPercentileMicroseconds(double fraction) const noexcept;
+    
+    juce::int64 getMaxMicroseconds() const noexcept { return maxMicroseconds.load(std::memory_order_relaxed); }
+    juce::uint64 getCount() const noexcept           { return count.load(std::memory_order_relaxed); }
+    
+    /** Clears all buckets. Measurements recorded at the same time may be lost. */
+    void reset() noexcept;
+
+private:
+    static constexpr int numLinearBuckets = 32;
+    static constexpr int subBucketsPerOctave = 8;
+    static constexpr int numOctaves = 22;   // 2^5 .. 2^27 us
+    static constexpr int numBuckets = numLinearBuckets + numOctaves * subBucketsPerOctave;
+    
+    std::array<std::atomic<juce::uint32>, numBuckets> buckets {};
+    std::atomic<juce::uint64> count { 0 };
+    std::atomic<juce::int64> maxMicroseconds { 0 };
+    
+    static int getBucketIndex(juce::int64 microseconds) noexcept;
+    static juce::int64 getBucketUpperBound(int index) noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyHistogram)
+};
+
+//==============================================================================
+/**
+    Per-stage latency histograms for the key-to-host path:
+    
+    key event -> mapper lookup -> enqueue (addMidiMessageToBuffer)
+              -> processBlock drain -> sample offset in the block
+    
+    The editor records the first two stages, the audio thread the rest.
+*/
+class LatencyStats
+{
+public:
+    enum class Stage
+    {
+        keyToLookup,        // keyPressed/keyStateChanged entry until the notes are looked up
+        lookupToEnqueue,    // Notes looked up until all of them are queued for the processor
+        queueWait,          // Queued until processBlock picks the event up
+        blockOffset,        // Sample offset the event lands on, as time into the block
+        keyToOutput,        // Key event until the event's position in the host buffer
+        numStages
+    };
+    
+    static constexpr int numStages = (int)Stage::numStages;
+    
+    LatencyStats() = default;
+    
+    /** Records a stage's duration given as high-resolution ticks (any thread, wait-free apart from the max) */
+    void recordTicks(Stage stage, juce::int64 ticks) noexcept;
+    
+    /** Records a stage's duration in microseconds (any thread) */
+    void recordMicroseconds(Stage stage, juce::int64 microseconds) noexcept;
+    
+    const LatencyHistogram& getHistogram(Stage stage) const noexcept { return histograms[(size_t)stage]; }
+    
+    void reset() noexcept;
+    
+    /** One line per stage: count, p50, p99 and max in milliseconds */
+    juce::String createReport() const;
+    
+    /** Writes the report with a timestamp to a new file. Returns the file, or {} on failure. */
+    juce::File writeReportFile() const;
+    
+    static juce::String getStageName(Stage stage);
+
+private:
+    std::array<LatencyHistogram, (size_t)numStages> histograms;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyStats)
+};
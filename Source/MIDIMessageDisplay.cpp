@@ -2,99 +2,66 @@
 
 //==============================================================================
 MIDIMessageDisplay::MIDIMessageDisplay()
-    : expanded(true), needsUpdate(false)
-{
-    // Setup message log
-    addAndMakeVisible(messageLog);
-    messageLog.setMultiLine(true);
-    messageLog.setReadOnly(true);
-    messageLog.setScrollbarsShown(true);
-    messageLog.setCaretVisible(false);
-    messageLog.setPopupMenuEnabled(false);
-    messageLog.setColour(juce::TextEditor::backgroundColourId, juce::Colours::black);
-    messageLog.setColour(juce::TextEditor::textColourId, juce::Colours::lightgreen);
-    messageLog.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+    : expanded(true), needsUpdate(false),
+      referenceTicks(juce::Time::getHighResolutionTicks()),
+      referenceMillis(juce::Time::currentTimeMillis())
+{
+    // The whole history is allocated up front; logging never allocates
+    history.resize((size_t)historyCapacity);
+    
+    // Setup message list - rows are formatted on demand by paintListBoxItem
+    addAndMakeVisible(messageList);
+    messageList.setModel(this);
+    messageList.setRowHeight(16);
+    messageList.setMultipleSelectionEnabled(false);
+    messageList.setColour(juce::ListBox::backgroundColourId, juce::Colours::black);
     
     // Setup toggle button
     addAndMakeVisible(toggleButton);
     toggleButton.setButtonText("MIDI Messages");
     toggleButton.onClick = [this]() { setExpanded(!expanded); };
     
-    // Start timer for async updates (30 FPS is plenty for a log display)
-    startTimer(33);
-    
     setSize(400, 150);
 }
 
 MIDIMessageDisplay::~MIDIMessageDisplay()
 {
-    stopTimer();
+    messageList.setModel(nullptr);
 }
 
-void MIDIMessageDisplay::addMidiMessage(const juce::MidiMessage& message)
+void MIDIMessageDisplay::addEmittedEvent(const MidiCaptureQueue::Event& event)
 {
-    // NON-BLOCKING: Just add to queue, process later on timer
-    const juce::ScopedLock lock(queueLock);
-    pendingMessages.add(message);
+    history[(size_t)(totalEventsLogged & (historyCapacity - 1))] = event;
+    ++totalEventsLogged;
     needsUpdate = true;
 }
 
-void MIDIMessageDisplay::processPendingMessages()
+void MIDIMessageDisplay::setNumDroppedEvents(juce::uint64 numDropped)
 {
-    juce::Array<juce::MidiMessage> messagesToProcess;
-    
-    // Quickly grab pending messages under lock
+    if (numDropped != numDroppedEvents)
     {
-        const juce::ScopedLock lock(queueLock);
-        messagesToProcess.swapWith(pendingMessages);
-        needsUpdate = false;
+        numDroppedEvents = numDropped;
+        toggleButton.setButtonText("MIDI Messages (" + juce::String(numDroppedEvents) + " dropped)");
     }
-    
-    // Process messages without holding the lock
-    for (const auto& message : messagesToProcess)
+}
+
+void MIDIMessageDisplay::flushPendingUpdates()
+{
+    // Collapsed: keep recording, but leave the list alone until it is shown again
+    if (needsUpdate && expanded)
     {
-        juce::String messageText;
-        
-        if (message.isNoteOn())
-        {
-            messageText = "Note ON:  " + StradellaKeyboardMapper::getMidiNoteName(message.getNoteNumber()) 
-                        + " (MIDI: " + juce::String(message.getNoteNumber()) + ")"
-                        + " Vel: " + juce::String(message.getVelocity());
-        }
-        else if (message.isNoteOff())
-        {
-            messageText = "Note OFF: " + StradellaKeyboardMapper::getMidiNoteName(message.getNoteNumber())
-                        + " (MIDI: " + juce::String(message.getNoteNumber()) + ")";
-        }
-        else
-        {
-            messageText = "MIDI: " + message.getDescription();
-        }
-        
-        // Add timestamp
-        auto now = juce::Time::getCurrentTime();
-        messageText = now.formatted("[%H:%M:%S] ") + messageText;
-        
-        messageHistory.add(messageText);
-        
-        // Keep only the last maxMessages
-        while (messageHistory.size() > maxMessages)
-            messageHistory.remove(0);
-    }
-    
-    // Update display once for all messages
-    if (messagesToProcess.size() > 0)
+        needsUpdate = false;
         updateMessageDisplay();
+    }
 }
 
 void MIDIMessageDisplay::clearMessages()
 {
-    {
-        const juce::ScopedLock lock(queueLock);
-        pendingMessages.clear();
-        messageHistory.clear();
-    }
-    // Update display immediately (outside lock) to show cleared state
+    totalEventsLogged = 0;
+    firstRowSequence = 0;
+    needsUpdate = false;
+    
+    // Update display immediately to show cleared state
     updateMessageDisplay();
 }
 
@@ -103,28 +70,115 @@ void MIDIMessageDisplay::setExpanded(bool shouldBeExpanded)
     if (expanded != shouldBeExpanded)
     {
         expanded = shouldBeExpanded;
-        messageLog.setVisible(expanded);
+        messageList.setVisible(expanded);
         resized();
+        
+        // Catch up with anything logged while collapsed
+        flushPendingUpdates();
+    }
+}
+
+int MIDIMessageDisplay::getNumStoredEvents() const noexcept
+{
+    return (int)juce::jmin(totalEventsLogged, (juce::int64)historyCapacity);
+}
+
+const MIDIMessageDisplay::LoggedEvent* MIDIMessageDisplay::getEventForRow(int row) const noexcept
+{
+    // Events logged since the last update may already have overwritten the row's slot
+    const auto sequence = firstRowSequence + row;
+    
+    if (sequence < totalEventsLogged - getNumStoredEvents() || sequence >= totalEventsLogged)
+        return nullptr;
+    
+    return &history[(size_t)(sequence & (historyCapacity - 1))];
+}
+
+juce::String MIDIMessageDisplay::formatEvent(const LoggedEvent& event) const
+{
+    const juce::MidiMessage message(event.data, (int)event.size);
+    juce::String messageText;
+    
+    if (message.isNoteOn())
+    {
+        messageText = "Note ON:  " + StradellaKeyboardMapper::getMidiNoteName(message.getNoteNumber()) 
+                    + " (MIDI: " + juce::String(message.getNoteNumber()) + ")"
+                    + " Vel: " + juce::String(message.getVelocity());
+    }
+    else if (message.isNoteOff())
+    {
+        messageText = "Note OFF: " + StradellaKeyboardMapper::getMidiNoteName(message.getNoteNumber())
+                    + " (MIDI: " + juce::String(message.getNoteNumber()) + ")";
     }
+    else
+    {
+        messageText = "MIDI: " + message.getDescription();
+    }
+    
+    // Add the block's timestamp (to the millisecond), then where in which block the host got it
+    const auto elapsedMillis = (juce::int64)std::floor(juce::Time::highResolutionTicksToSeconds(event.timestampTicks - referenceTicks) * 1000.0);
+    const juce::Time blockTime(referenceMillis + elapsedMillis);
+    
+    return blockTime.formatted("[%H:%M:%S.") + juce::String(blockTime.getMilliseconds()).paddedLeft('0', 3) + "] "
+         + "#" + juce::String(event.blockIndex) + " +" + juce::String(event.sampleOffset).paddedRight(' ', 4) + " "
+         + messageText;
 }
 
 void MIDIMessageDisplay::updateMessageDisplay()
 {
-    juce::String allMessages;
-    for (const auto& msg : messageHistory)
+    // Stay at the newest message unless the user has scrolled back through the history
+    bool followLatest = true;
+    
+    if (auto* viewport = messageList.getViewport())
+        if (auto* content = viewport->getViewedComponent())
+            followLatest = viewport->getViewPositionY() + viewport->getViewHeight()
+                               >= content->getHeight() - messageList.getRowHeight();
+    
+    // Row 0 becomes the oldest event still in the ring; rows before it have been overwritten
+    const auto oldestStoredSequence = totalEventsLogged - getNumStoredEvents();
+    const auto numRowsDropped = (int)juce::jlimit((juce::int64)0, (juce::int64)numRows, oldestStoredSequence - firstRowSequence);
+    
+    firstRowSequence = oldestStoredSequence;
+    numRows = getNumStoredEvents();
+    messageList.updateContent();
+    
+    if (followLatest && numRows > 0)
     {
-        allMessages += msg + "\n";
+        messageList.scrollToEnsureRowIsOnscreen(numRows - 1);
+    }
+    else if (numRowsDropped > 0)
+    {
+        // Keep a scrolled-back view (and its selection) on the same events
+        if (auto* viewport = messageList.getViewport())
+            viewport->setViewPosition(viewport->getViewPositionX(),
+                                      juce::jmax(0, viewport->getViewPositionY() - numRowsDropped * messageList.getRowHeight()));
+        
+        const auto selectedRow = messageList.getSelectedRow();
+        
+        if (selectedRow >= numRowsDropped)
+            messageList.selectRow(selectedRow - numRowsDropped, true);
+        else if (selectedRow >= 0)
+            messageList.deselectAllRows();
     }
     
-    messageLog.setText(allMessages, false);
-    messageLog.moveCaretToEnd();
+    messageList.repaint();
+}
+
+int MIDIMessageDisplay::getNumRows()
+{
+    return numRows;
 }
 
-void MIDIMessageDisplay::timerCallback()
+void MIDIMessageDisplay::paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected)
 {
-    // Process any pending messages asynchronously
-    if (needsUpdate)
-        processPendingMessages();
+    const auto* event = getEventForRow(rowNumber);
+    
+    if (event == nullptr)
+        return;
+    
+    g.setColour(juce::Colours::lightgreen);
+    g.setFont(juce::Font(juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+    g.drawText(formatEvent(*event), 4, 0, width - 8, height, juce::Justification::centredLeft);
 }
 
 void MIDIMessageDisplay::paint(juce::Graphics& g)
@@ -142,7 +196,7 @@ void MIDIMessageDisplay::resized()
     // Message log below if expanded
     if (expanded)
     {
-        messageLog.setBounds(area.reduced(2));
+        messageList.setBounds(area.reduced(2));
     }
 }
 
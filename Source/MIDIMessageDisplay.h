@@ -2,21 +2,38 @@
 
 #include <JuceHeader.h>
 #include "StradellaKeyboardMapper.h"
+#include "MidiCaptureQueue.h"
 
 //==============================================================================
 /**
     A component that displays MIDI messages in real-time with collapsible functionality.
-    Uses asynchronous updates to avoid blocking MIDI output.
+    
+    Shows what processBlock sent to the host, with block index and sample offset.
+    Events are appended from the editor's frame update (see GuiFrameScheduler) as
+    raw records into a fixed-capacity ring, and the list view only formats the rows
+    that are on screen, so the cost per frame doesn't grow with the history length.
+    Nothing is formatted or repainted while the display is collapsed.
+    
+    Rows are anchored to absolute event numbers, not ring positions: when the
+    oldest events are overwritten the rows move up by the same amount and a view
+    scrolled back through the history is moved with them, so it stays on the
+    events it showed.
 */
 class MIDIMessageDisplay : public juce::Component,
-                           private juce::Timer
+                           private juce::ListBoxModel
 {
 public:
     MIDIMessageDisplay();
     ~MIDIMessageDisplay() override;
     
-    /** Adds a MIDI message to the display (non-blocking, queued for async update) */
-    void addMidiMessage(const juce::MidiMessage& message);
+    /** Records an event the processor emitted. Shown on the next flushPendingUpdates(). */
+    void addEmittedEvent(const MidiCaptureQueue::Event& event);
+    
+    /** Shows how many events the capture queue has dropped so far */
+    void setNumDroppedEvents(juce::uint64 numDropped);
+    
+    /** Updates the visible rows if messages were added since the last call (no-op while collapsed) */
+    void flushPendingUpdates();
     
     /** Clears all messages */
     void clearMessages();
@@ -32,19 +49,35 @@ public:
     void mouseDown(const juce::MouseEvent& event) override;
 
 private:
-    juce::TextEditor messageLog;
+    // Logged events are kept raw and formatted only when their row is painted
+    using LoggedEvent = MidiCaptureQueue::Event;
+    
+    // Power of two so ring positions are a mask, not a division
+    static constexpr int historyCapacity = 1 << 17;
+    
+    juce::ListBox messageList;
     juce::TextButton toggleButton;
     bool expanded;
     
-    juce::StringArray messageHistory;
-    juce::CriticalSection queueLock;
-    juce::Array<juce::MidiMessage> pendingMessages;
-    static constexpr int maxMessages = 100;
+    std::vector<LoggedEvent> history;
+    juce::int64 totalEventsLogged = 0;
+    juce::int64 firstRowSequence = 0;           // Event number shown in row 0
+    int numRows = 0;                            // Rows the list knows about since the last update
+    juce::uint64 numDroppedEvents = 0;
     bool needsUpdate;
     
-    void timerCallback() override;
+    // Wall-clock time at a known tick count, for showing capture ticks as time of day
+    const juce::int64 referenceTicks;
+    const juce::int64 referenceMillis;
+    
+    int getNumStoredEvents() const noexcept;
+    const LoggedEvent* getEventForRow(int row) const noexcept;
+    juce::String formatEvent(const LoggedEvent& event) const;
     void updateMessageDisplay();
-    void processPendingMessages();
+    
+    // ListBoxModel
+    int getNumRows() override;
+    void paintListBoxItem(int rowNumber, juce::Graphics& g, int width, int height, bool rowIsSelected) override;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MIDIMessageDisplay)
 };
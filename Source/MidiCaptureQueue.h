@@ -0,0 +1,48 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MpscRing.h"
+
+//==============================================================================
+/**
+    Bounded lock-free multi-producer/single-consumer queue of MIDI events for
+    display, stamped with the high-resolution tick time they were captured at.
+    
+    The processor publishes every event it writes to the host's MidiBuffer,
+    with its block index and sample offset, and the GUI frame update drains
+    them. Pushing never locks, allocates or waits; when the queue is full the
+    event is dropped and counted (see MpscRing).
+*/
+class MidiCaptureQueue
+{
+public:
+    /** A short MIDI message as the host received it */
+    struct Event
+    {
+        juce::int64 timestampTicks;     // Start of the block it was emitted in
+        juce::int64 blockIndex;         // processBlock calls since prepareToPlay
+        int sampleOffset;               // Position inside that block
+        juce::uint8 data[3];
+        juce::uint8 size;
+    };
+    
+    static constexpr int capacity = 4096;       // Events, power of two
+    
+    //==============================================================================
+    MidiCaptureQueue() = default;
+    
+    /** Queues an event. Returns false if it was dropped. Any thread. */
+    bool push(const Event& event) noexcept      { return ring.push(event); }
+    
+    /** Calls the callback for every published event in order, then frees their slots. Consumer only. */
+    template <typename Callback>
+    void drain(Callback&& callback)             { ring.drain(std::forward<Callback>(callback)); }
+    
+    /** Number of events lost because the queue was full */
+    juce::uint64 getNumDroppedEvents() const noexcept { return ring.getNumDroppedItems(); }
+
+private:
+    MpscRing<Event, capacity> ring;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiCaptureQueue)
+};
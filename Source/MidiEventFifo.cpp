@@ -0,0 +1,43 @@
+#include "MidiEventFifo.h"
+
+//==============================================================================
+bool MidiEventFifo::push(const juce::MidiMessage& message, juce::int64 timestampTicks) noexcept
+{
+    const int size = message.getRawDataSize();
+
+    // Only short messages travel through this queue (no SysEx)
+    if (size <= 0 || size > 3)
+    {
+        jassertfalse;
+        return false;
+    }
+
+    Event event {};
+    event.timestampTicks = timestampTicks;
+    event.enqueueTicks = juce::Time::getHighResolutionTicks();
+    std::memcpy(event.data, message.getRawData(), (size_t)size);
+    event.size = (juce::uint8)size;
+    return write(event);
+}
+
+bool MidiEventFifo::pushCommand(juce::uint8 commandFlag, juce::uint8 value, juce::int64 timestampTicks) noexcept
+{
+    Event event {};
+    event.timestampTicks = timestampTicks;
+    event.enqueueTicks = juce::Time::getHighResolutionTicks();
+    event.data[0] = value;
+    event.size = 0;
+    event.flags = commandFlag;
+    return write(event);
+}
+
+bool MidiEventFifo::write(const Event& event) noexcept
+{
+    const auto scope = fifo.write(1);
+
+    if (scope.blockSize1 + scope.blockSize2 == 0)
+        return false; // Queue full - the audio thread is not draining
+
+    events[(size_t)(scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = event;
+    return true;
+}
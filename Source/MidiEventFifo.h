@@ -0,0 +1,107 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Fixed-capacity, wait-free single-producer/single-consumer queue carrying
+    short MIDI events from the editor (message thread) to processBlock (audio thread).
+    All event storage is preallocated, so neither side ever locks or allocates.
+*/
+class MidiEventFifo
+{
+public:
+    /** A preallocated short MIDI event (note on/off, controller, etc.) */
+    struct Event
+    {
+        juce::int64 timestampTicks;     // Capture time (Time::getHighResolutionTicks)
+        juce::int64 enqueueTicks;       // When it was pushed, for the latency statistics
+        juce::uint8 data[3];
+        juce::uint8 size;               // 0 for commands (see pushCommand)
+        juce::uint8 flags;              // Command flag below, 0 for MIDI messages
+    };
+
+    /** Command: re-articulate every sounding note at once. data[0] holds the new velocity. */
+    static constexpr juce::uint8 bellowsReversalFlag = 0x01;
+
+    static constexpr int capacity = 1024;
+
+    //==============================================================================
+    MidiEventFifo() = default;
+
+    /** Pushes a message captured at the given high-resolution tick time. Producer thread only.
+        Returns false if the queue is full or the message is not a short message.
+    */
+    bool push(const juce::MidiMessage& message, juce::int64 timestampTicks) noexcept;
+    
+    /** Pushes a command event that carries no MIDI bytes of its own, just the
+        command flag and a one-byte argument. Producer thread only.
+    */
+    bool pushCommand(juce::uint8 commandFlag, juce::uint8 value, juce::int64 timestampTicks) noexcept;
+
+    /** Fast path check for pending events - safe to call from any thread */
+    bool hasPendingEvents() const noexcept { return fifo.getNumReady() > 0; }
+    
+    /** Number of events waiting - safe to call from any thread */
+    int getNumPendingEvents() const noexcept { return fifo.getNumReady(); }
+
+    /** Calls the callback for every pending event, then removes them. Consumer thread only. */
+    template <typename Callback>
+    void drain(Callback&& callback) noexcept
+    {
+        const auto scope = fifo.read(fifo.getNumReady());
+        scope.forEach([this, &callback](int index) { callback(events[(size_t)index]); });
+    }
+
+    /** Drains this queue and another one together, calling the callback in timestampTicks
+        order. Each queue is already in capture order, so this is a two-way merge.
+        Consumer thread only (of both queues).
+    */
+    template <typename Callback>
+    void drainMerged(MidiEventFifo& other, Callback&& callback) noexcept
+    {
+        const auto scope = fifo.read(fifo.getNumReady());
+        const auto otherScope = other.fifo.read(other.fifo.getNumReady());
+        
+        const int numEvents = scope.blockSize1 + scope.blockSize2;
+        const int numOtherEvents = otherScope.blockSize1 + otherScope.blockSize2;
+        int position = 0, otherPosition = 0;
+        
+        while (position < numEvents || otherPosition < numOtherEvents)
+        {
+            const Event* next = position < numEvents ? &getEvent(scope, position) : nullptr;
+            const Event* otherNext = otherPosition < numOtherEvents ? &other.getEvent(otherScope, otherPosition) : nullptr;
+            
+            // Ties go to this queue
+            if (otherNext == nullptr || (next != nullptr && next->timestampTicks <= otherNext->timestampTicks))
+            {
+                callback(*next);
+                ++position;
+            }
+            else
+            {
+                callback(*otherNext);
+                ++otherPosition;
+            }
+        }
+    }
+    
+    /** Discards all pending events. Consumer thread only. */
+    void clear() noexcept { fifo.read(fifo.getNumReady()); }
+
+private:
+    // AbstractFifo keeps one slot free to tell "full" from "empty"
+    juce::AbstractFifo fifo { capacity + 1 };
+    std::array<Event, (size_t)capacity + 1> events {};
+
+    bool write(const Event& event) noexcept;
+    
+    /** The event at a position inside a read scope */
+    const Event& getEvent(const juce::AbstractFifo::ScopedRead& scope, int position) const noexcept
+    {
+        return events[(size_t)(position < scope.blockSize1 ? scope.startIndex1 + position
+                                                           : scope.startIndex2 + position - scope.blockSize1)];
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiEventFifo)
+};
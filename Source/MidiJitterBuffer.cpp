@@ -0,0 +1,77 @@
+#include "MidiJitterBuffer.h"
+
+//==============================================================================
+void MidiJitterBuffer::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+    blockStartSample = 0;
+    
+    // Held events may be note-offs for notes already sent, so they still go out
+    for (int i = 0; i < numDelayedEvents; ++i)
+        delayedEvents[(size_t)i].targetSample = 0;
+}
+
+bool MidiJitterBuffer::addEvent(const MidiEventFifo::Event& event, juce::int64 blockStartTicks, int latencySamples) noexcept
+{
+    const int capacity = (int)delayedEvents.size();
+    
+    // Only note-offs may use the headroom, and a full buffer gives up a note-on for one
+    if (isNoteOff(event))
+    {
+        if (numDelayedEvents == capacity && !evictLatestNoteOn())
+            return false;
+    }
+    else if (numDelayedEvents >= capacity - noteOffHeadroom)
+    {
+        return false;
+    }
+    
+    // How long ago (in samples) the event was captured, relative to this block's start
+    const double secondsAgo = juce::Time::highResolutionTicksToSeconds(blockStartTicks - event.timestampTicks);
+    const auto samplesAgo = (juce::int64)(secondsAgo * sampleRate);
+    
+    delayedEvents[(size_t)numDelayedEvents++] = { blockStartSample - samplesAgo + latencySamples, event };
+    return true;
+}
+
+int MidiJitterBuffer::scheduleEvents(MidiEventFifo& fifo, MidiEventFifo& commands, juce::int64 blockStartTicks,
+                                     int latencySamples) noexcept
+{
+    int numDropped = 0;
+    
+    // Merged in capture order, so held events stay sorted by target sample
+    fifo.drainMerged(commands, [this, blockStartTicks, latencySamples, &numDropped](const MidiEventFifo::Event& event)
+    {
+        if (!addEvent(event, blockStartTicks, latencySamples))
+            ++numDropped;
+    });
+    
+    return numDropped;
+}
+
+bool MidiJitterBuffer::evictLatestNoteOn() noexcept
+{
+    for (int i = numDelayedEvents; --i >= 0;)
+    {
+        if (isNoteOn(delayedEvents[(size_t)i].event))
+        {
+            // Shifting the later events down keeps them sorted
+            std::move(delayedEvents.begin() + i + 1, delayedEvents.begin() + numDelayedEvents, delayedEvents.begin() + i);
+            --numDelayedEvents;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+bool MidiJitterBuffer::isNoteOn(const MidiEventFifo::Event& event) noexcept
+{
+    return event.size >= 3 && (event.data[0] & 0xf0) == 0x90 && event.data[2] > 0;
+}
+
+bool MidiJitterBuffer::isNoteOff(const MidiEventFifo::Event& event) noexcept
+{
+    const int status = event.data[0] & 0xf0;
+    return event.size >= 3 && (status == 0x80 || (status == 0x90 && event.data[2] == 0));
+}
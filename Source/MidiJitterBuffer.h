@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiEventFifo.h"
+
+//==============================================================================
+/**
+    Delays editor events by a constant number of samples relative to the time
+    they were captured, so every event lands at a deterministic sample offset
+    regardless of when the next processBlock call happens.
+    
+    Events whose target position lies beyond the current block are held in a
+    preallocated buffer until their block comes round. Audio thread only.
+    
+    The last noteOffHeadroom slots only take note-offs, and if even those run out
+    the latest held note-on makes room, so a full buffer never leaves a note stuck.
+*/
+class MidiJitterBuffer
+{
+public:
+    static constexpr int noteOffHeadroom = 128;
+    
+    MidiJitterBuffer() = default;
+    
+    /** Resets the sample clock. Held events are kept and become due at the start of the next block. */
+    void prepare(double sampleRate);
+    
+    /** Returns true if events are waiting for a later block */
+    bool hasDelayedEvents() const noexcept { return numDelayedEvents > 0; }
+    
+    /** Drains both FIFOs in capture order, schedules each event latencySamples after its
+        capture time and passes everything due in this block to emit(event, sampleOffset).
+        Must be called for every block while fixed-latency mode is active.
+        Returns the number of events dropped because the buffer was full.
+    */
+    template <typename EmitCallback>
+    int process(MidiEventFifo& fifo, MidiEventFifo& commands, juce::int64 blockStartTicks, int numSamples,
+                int latencySamples, EmitCallback&& emit) noexcept
+    {
+        int numDropped = 0;
+        
+        if (fifo.hasPendingEvents() || commands.hasPendingEvents())
+            numDropped = scheduleEvents(fifo, commands, blockStartTicks, latencySamples);
+        
+        const juce::int64 blockEndSample = blockStartSample + numSamples;
+        int numRemaining = 0;
+        
+        // Held events stay in capture order, so compacting in place keeps them sorted
+        for (int i = 0; i < numDelayedEvents; ++i)
+        {
+            const auto& delayed = delayedEvents[(size_t)i];
+            
+            if (delayed.targetSample < blockEndSample)
+            {
+                // Events that are already late (latency shorter than the callback jitter) go at the start
+                const auto sampleOffset = (int)juce::jmax((juce::int64)0, delayed.targetSample - blockStartSample);
+                emit(delayed.event, sampleOffset);
+            }
+            else
+            {
+                delayedEvents[(size_t)numRemaining++] = delayed;
+            }
+        }
+        
+        numDelayedEvents = numRemaining;
+        blockStartSample += numSamples;
+        return numDropped;
+    }
+
+private:
+    struct DelayedEvent
+    {
+        juce::int64 targetSample;
+        MidiEventFifo::Event event;
+    };
+    
+    double sampleRate = 44100.0;
+    juce::int64 blockStartSample = 0;   // Running sample clock at the start of the current block
+    
+    std::array<DelayedEvent, (size_t)MidiEventFifo::capacity> delayedEvents {};
+    int numDelayedEvents = 0;
+    
+    /** Returns false if the buffer had no room for the event */
+    bool addEvent(const MidiEventFifo::Event& event, juce::int64 blockStartTicks, int latencySamples) noexcept;
+    int scheduleEvents(MidiEventFifo& fifo, MidiEventFifo& commands, juce::int64 blockStartTicks, int latencySamples) noexcept;
+    
+    /** Removes the latest held note-on, returning false if there is none */
+    bool evictLatestNoteOn() noexcept;
+    
+    static bool isNoteOn(const MidiEventFifo::Event& event) noexcept;
+    static bool isNoteOff(const MidiEventFifo::Event& event) noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiJitterBuffer)
+};
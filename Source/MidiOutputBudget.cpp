@@ -0,0 +1,134 @@
+#include "MidiOutputBudget.h"
+
+//==============================================================================
+void MidiOutputBudget::prepare(int maxStagedEvents)
+{
+    maxStagedEvents = juce::jmax(1, maxStagedEvents);
+    
+    staging.clear();
+    staging.ensureSize((size_t)maxStagedEvents * (size_t)bytesPerEvent);
+    stagedEvents.resize((size_t)maxStagedEvents);
+    
+    setMaxEventsPerBlock(maxEventsPerBlock);
+}
+
+void MidiOutputBudget::setMaxEventsPerBlock(int newMaxEventsPerBlock) noexcept
+{
+    maxEventsPerBlock = juce::jlimit(1, juce::jmax(1, (int)stagedEvents.size()), newMaxEventsPerBlock);
+}
+
+MidiOutputBudget::Decisions MidiOutputBudget::write(juce::MidiBuffer& output) noexcept
+{
+    Decisions decisions;
+    const int numStaged = staging.getNumEvents();
+    
+    // Within budget, or more than prepare() allowed for: nothing to decide, write it all
+    if (numStaged <= maxEventsPerBlock || numStaged > (int)stagedEvents.size())
+    {
+        decisions.budgetExceeded = numStaged > maxEventsPerBlock;
+        output.addEvents(staging, 0, -1, 0);
+        staging.clear();
+        return decisions;
+    }
+    
+    int index = 0;
+    
+    for (const auto metadata : staging)
+    {
+        auto& event = stagedEvents[(size_t)index++];
+        event.samplePosition = metadata.samplePosition;
+        event.size = (juce::uint8)juce::jmin(3, metadata.numBytes);
+        event.keep = true;
+        std::memcpy(event.data, metadata.data, event.size);
+    }
+    
+    decisions.numControllersCoalesced = coalesceControllers(numStaged);
+    
+    const int numToDrop = numStaged - decisions.numControllersCoalesced - maxEventsPerBlock;
+    
+    if (numToDrop > 0)
+        decisions.numNoteOnsDropped = dropRedundantNoteOns(numStaged, numToDrop);
+    
+    decisions.budgetExceeded = numToDrop > decisions.numNoteOnsDropped;
+    
+    for (int i = 0; i < numStaged; ++i)
+    {
+        const auto& event = stagedEvents[(size_t)i];
+        
+        if (event.keep)
+            output.addEvent(event.data, (int)event.size, event.samplePosition);
+    }
+    
+    staging.clear();
+    return decisions;
+}
+
+//==============================================================================
+int MidiOutputBudget::coalesceControllers(int numStaged) noexcept
+{
+    for (auto& channel : laterControllers)
+        channel.fill(0);
+    
+    int numCoalesced = 0;
+    
+    // Walking backwards, the first value seen for a controller is its final one
+    for (int i = numStaged; --i >= 0;)
+    {
+        auto& event = stagedEvents[(size_t)i];
+        
+        if ((event.data[0] & 0xf0) != 0xb0 || event.size < 3)
+            continue;
+        
+        if (testAndSet(laterControllers, event.data[0], event.data[1]))
+        {
+            event.keep = false;
+            ++numCoalesced;
+        }
+    }
+    
+    return numCoalesced;
+}
+
+int MidiOutputBudget::dropRedundantNoteOns(int numStaged, int numToDrop) noexcept
+{
+    for (auto& channel : laterNoteOffs)
+        channel.fill(0);
+    
+    int numDropped = 0;
+    
+    // The note-off that follows a dropped note-on still goes out, so nothing is left hanging
+    for (int i = numStaged; --i >= 0 && numDropped < numToDrop;)
+    {
+        auto& event = stagedEvents[(size_t)i];
+        const int status = event.data[0] & 0xf0;
+        
+        if ((status != 0x80 && status != 0x90) || event.size < 3)
+            continue;
+        
+        if (status == 0x80 || event.data[2] == 0)
+        {
+            testAndSet(laterNoteOffs, event.data[0], event.data[1]);
+        }
+        else if (isSet(laterNoteOffs, event.data[0], event.data[1]))
+        {
+            event.keep = false;
+            ++numDropped;
+        }
+    }
+    
+    return numDropped;
+}
+
+bool MidiOutputBudget::isSet(const ChannelBits& bits, juce::uint8 statusByte, juce::uint8 number) noexcept
+{
+    const auto word = bits[(size_t)(statusByte & 0x0f)][(size_t)((number & 0x7f) >> 6)];
+    return (word & ((juce::uint64)1 << (number & 63))) != 0;
+}
+
+bool MidiOutputBudget::testAndSet(ChannelBits& bits, juce::uint8 statusByte, juce::uint8 number) noexcept
+{
+    const bool wasSet = isSet(bits, statusByte, number);
+    
+    bits[(size_t)(statusByte & 0x0f)][(size_t)((number & 0x7f) >> 6)] |= (juce::uint64)1 << (number & 63);
+    return wasSet;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Stages a block's output events in preallocated storage and copies them to
+    the host's buffer within a fixed event budget.
+
+    Within the budget every staged event is written unchanged. Over it, the
+    overflow policy thins the block in this order:
+    1. Controller values that a later value for the same controller in this
+       block replaces are dropped (the final value always goes out).
+    2. Note-ons whose note is switched off again later in this block are
+       dropped, latest first, until the block fits.
+    Note-offs are never dropped. A block that still doesn't fit is written in
+    full and reported, rather than losing notes or leaving one stuck.
+
+    The staging storage is sized once for anything the pipeline can produce,
+    while the budget itself follows the current layout and can change between
+    blocks without allocating.
+
+    prepare() allocates; everything else is audio thread only.
+*/
+class MidiOutputBudget
+{
+public:
+    /** What the overflow policy did in one block */
+    struct Decisions
+    {
+        int numControllersCoalesced = 0;
+        int numNoteOnsDropped = 0;
+        bool budgetExceeded = false;    // Written over budget after the policy ran
+    };
+    
+    /** Bytes a MidiBuffer stores per short message: sample position, size and three data bytes */
+    static constexpr int bytesPerEvent = (int)(sizeof(juce::int32) + sizeof(juce::uint16) + 3);
+    
+    //==============================================================================
+    MidiOutputBudget() = default;
+    
+    /** Reserves room for up to maxStagedEvents events per block */
+    void prepare(int maxStagedEvents);
+    
+    /** Sets the per-block budget (clamped to the staging room). Never allocates. */
+    void setMaxEventsPerBlock(int newMaxEventsPerBlock) noexcept;
+    int getMaxEventsPerBlock() const noexcept   { return maxEventsPerBlock; }
+    
+    /** Bytes the host's buffer needs to hold a full budget without growing */
+    size_t getMaxBytesPerBlock() const noexcept { return (size_t)maxEventsPerBlock * (size_t)bytesPerEvent; }
+    
+    /** Where the block's events are generated, in time order */
+    juce::MidiBuffer& getStagingBuffer() noexcept { return staging; }
+    
+    /** Appends the staged events to output under the overflow policy, then empties the staging buffer */
+    Decisions write(juce::MidiBuffer& output) noexcept;
+
+private:
+    struct StagedEvent
+    {
+        int samplePosition;
+        juce::uint8 data[3];
+        juce::uint8 size;
+        bool keep;
+    };
+    
+    int maxEventsPerBlock = 1;
+    juce::MidiBuffer staging;
+    std::vector<StagedEvent> stagedEvents;  // Sized in prepare(), reused every block
+    
+    // Per channel bitsets for the backward passes: controllers already seen, notes switched off later
+    using ChannelBits = std::array<std::array<juce::uint64, 2>, 16>;
+    ChannelBits laterControllers {};
+    ChannelBits laterNoteOffs {};
+    
+    static bool isSet(const ChannelBits& bits, juce::uint8 statusByte, juce::uint8 number) noexcept;
+    static bool testAndSet(ChannelBits& bits, juce::uint8 statusByte, juce::uint8 number) noexcept;
+    
+    int coalesceControllers(int numStaged) noexcept;
+    int dropRedundantNoteOns(int numStaged, int numToDrop) noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MidiOutputBudget)
+};
@@ -1,19 +1,23 @@
 #include "MouseMidiExpression.h"
+#include "TraceLogger.h"
 
 //==============================================================================
 MouseMidiExpression::MouseMidiExpression()
 {
     // Initialize positions
-    lastMousePosition = juce::Desktop::getInstance().getMainMouseSource().getScreenPosition().toInt();
+    PositionSampler::Sample sample;
+    positionSampler.update();
+    positionSampler.getLatest(sample);
+    
+    lastMousePosition = sample.position;
     currentMousePosition = lastMousePosition;
-    lastMouseTime = juce::Time::currentTimeMillis();
-    lastXMovementTime = lastMouseTime;
+    lastXMovementTicks = juce::Time::getHighResolutionTicks();
     
     // Get desktop bounds for expression calculation
     screenBounds = juce::Desktop::getInstance().getDisplays().getPrimaryDisplay()->totalArea;
     
     // Initialize note velocity based on starting Y position
-    currentNoteVelocity = calculateVelocityFromYPosition(lastMousePosition.y);
+    currentNoteVelocity = curves.getTable(ResponseCurveSet::velocityCurve).apply(calculateVelocityFromYPosition(lastMousePosition.y));
 }
 
 MouseMidiExpression::~MouseMidiExpression()
@@ -23,52 +27,119 @@ MouseMidiExpression::~MouseMidiExpression()
 
 void MouseMidiExpression::startTracking()
 {
-    // Start timer to poll mouse position globally
-    startTimer(16); // ~60 Hz polling
+    // The position is read and timestamped on the message thread, then analysed on the
+    // high-resolution timer thread. Both run at the sampling rate.
+    const int intervalMilliseconds = juce::jmax(1, 1000 / samplingRateHz.load());
+    
+    lastCallbackTicks = 0;
+    positionSampler.start(intervalMilliseconds);
+    startTimer(intervalMilliseconds);
 }
 
 void MouseMidiExpression::stopTracking()
 {
     stopTimer();
+    positionSampler.stop();
 }
 
-void MouseMidiExpression::timerCallback()
+void MouseMidiExpression::setSamplingRateHz(int newRateHz)
 {
-    // Poll mouse position globally
-    auto mousePos = juce::Desktop::getInstance().getMainMouseSource().getScreenPosition().toInt();
+    samplingRateHz = juce::jlimit(minSamplingRateHz, maxSamplingRateHz, newRateHz);
+    
+    if (isTimerRunning())
+        startTracking();
+}
+
+void MouseMidiExpression::hiResTimerCallback()
+{
+    // A callback more than half a period late counts as an overrun
+    const auto callbackTicks = juce::Time::getHighResolutionTicks();
+    
+    if (performanceCounters != nullptr && lastCallbackTicks != 0
+        && juce::Time::highResolutionTicksToSeconds(callbackTicks - lastCallbackTicks) > 1.5 / samplingRateHz.load(std::memory_order_relaxed))
+        performanceCounters->add(PerformanceCounters::Counter::timerOverruns);
+    
+    lastCallbackTicks = callbackTicks;
+    
+    // The latest position the message thread has read, with the time it was read at
+    PositionSampler::Sample sample;
     
-    // Process on position change OR to handle CC decay
-    if (mousePos != currentMousePosition)
+    if (!positionSampler.getLatest(sample))
+        return;
+    
+    // Only movement matters here - the processor holds and decays the controllers itself
+    if (sample.position != currentMousePosition)
     {
-        processMouseMovement(mousePos);
+        processMouseMovement(sample.position, sample.ticks);
     }
-    else
+    else if (wasMovingInLastFrame)
+    {
+        // A pause longer than the decay delay ends the stroke, so the next movement
+        // in either direction doesn't count as a bellows reversal
+        const double secondsSinceLastXMovement = juce::Time::highResolutionTicksToSeconds(
+            juce::Time::getHighResolutionTicks() - lastXMovementTicks);
+        
+        if (secondsSinceLastXMovement > decayDelaySeconds)
+            wasMovingInLastFrame = false;
+    }
+}
+
+//==============================================================================
+void MouseMidiExpression::PositionSampler::start(int intervalMilliseconds)
+{
+    update();
+    startTimer(intervalMilliseconds);
+}
+
+void MouseMidiExpression::PositionSampler::update()
+{
+    // Timestamp the reading itself, not the moment the sampling thread notices it
+    const auto position = juce::Desktop::getInstance().getMainMouseSource().getScreenPosition().toInt();
+    const auto ticks = juce::Time::getHighResolutionTicks();
+    
+    // Packed as unsigned: positions left of or above the primary display are negative
+    const auto packed = ((juce::uint64)(juce::uint32)position.x << 32) | (juce::uint64)(juce::uint32)position.y;
+    const auto oldSequence = sequence.load(std::memory_order_relaxed);
+    
+    sequence.store(oldSequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    packedPosition.store(packed, std::memory_order_relaxed);
+    positionTicks.store(ticks, std::memory_order_relaxed);
+    
+    sequence.store(oldSequence + 2, std::memory_order_release);
+}
+
+bool MouseMidiExpression::PositionSampler::getLatest(Sample& result) const noexcept
+{
+    // The writer holds the lock for two stores, so a few attempts are plenty
+    for (int attempt = 0; attempt < 4; ++attempt)
     {
-        // Even if mouse hasn't moved, process to handle CC decay
-        juce::int64 currentTime = juce::Time::currentTimeMillis();
-        juce::int64 timeSinceLastXMovement = currentTime - lastXMovementTime;
+        const auto sequenceBefore = sequence.load(std::memory_order_acquire);
+        const auto packed = packedPosition.load(std::memory_order_relaxed);
+        const auto ticks = positionTicks.load(std::memory_order_relaxed);
         
-        // If we should be decaying, process movement with same position
-        if (timeSinceLastXMovement > decayDelayMs && (lastModulationValue > 0 || lastExpressionValue > 0))
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        if ((sequenceBefore & 1) == 0 && sequence.load(std::memory_order_relaxed) == sequenceBefore)
         {
-            processMouseMovement(mousePos);
+            result.position = { (int)(juce::int32)(juce::uint32)(packed >> 32), (int)(juce::int32)(juce::uint32)packed };
+            result.ticks = ticks;
+            return true;
         }
     }
+    
+    return false;
 }
 
 //==============================================================================
-void MouseMidiExpression::processMouseMovement(const juce::Point<int>& mousePos)
+void MouseMidiExpression::processMouseMovement(const juce::Point<int>& mousePos, juce::int64 captureTicks)
 {
     currentMousePosition = mousePos;
-    juce::int64 currentTime = juce::Time::currentTimeMillis();
-    juce::int64 timeDelta = currentTime - lastMouseTime;
     
-    // Avoid division by zero
-    if (timeDelta <= 0)
-        timeDelta = 1;
-    
-    // Calculate note velocity from Y position (127 at top, 0 at bottom)
-    currentNoteVelocity = calculateVelocityFromYPosition(mousePos.y);
+    // Calculate note velocity from Y position (127 at top, 0 at bottom), through its curve
+    const int yValue = calculateVelocityFromYPosition(mousePos.y);
+    currentNoteVelocity = curves.getTable(ResponseCurveSet::velocityCurve).apply(yValue);
     
     // Calculate X movement
     int deltaX = currentMousePosition.x - lastMousePosition.x;
@@ -85,13 +156,13 @@ void MouseMidiExpression::processMouseMovement(const juce::Point<int>& mousePos)
             // Direction changed! Trigger note retrigger callback
             if (onDirectionChange)
             {
-                onDirectionChange();
+                onDirectionChange(captureTicks);
             }
         }
         
         // Update direction
         isMovingRight = isMovingRightNow;
-        lastXMovementTime = currentTime;
+        lastXMovementTicks = captureTicks;
         wasMovingInLastFrame = true;
     }
     else
@@ -100,77 +171,23 @@ void MouseMidiExpression::processMouseMovement(const juce::Point<int>& mousePos)
         wasMovingInLastFrame = false;
     }
     
-    // Check if we should decay CC values (no X movement for decay delay time)
-    juce::int64 timeSinceLastXMovement = currentTime - lastXMovementTime;
-    bool shouldDecay = timeSinceLastXMovement > decayDelayMs;
-    
-    // Calculate CC values based on Y position, but only when moving in X
-    int cc1Value = 0;
-    int cc11Value = 0;
-    
+    // CC targets follow the Y position, but only while moving in X. They are refreshed on
+    // every movement sample so the processor knows to hold them; once updates stop it
+    // decays them to 0 on its own (see ControllerEnvelopeGenerator).
     if (isMovingInX)
     {
-        // Use Y position for CC values (same as note velocity)
-        int ccValue = currentNoteVelocity;
-        
-        // Apply curve
-        float normalized = (float)ccValue / 127.0f;
-        float curved = applyCurve(normalized);
-        ccValue = (int)(curved * 127.0f);
-        
-        // Both CCs use same value when moving
-        cc1Value = ccValue;
-        cc11Value = ccValue;
-    }
-    else if (shouldDecay)
-    {
-        // Smooth decay to 0 - each CC decays from its own last value
-        // Calculate remaining factor (1.0 = full value, 0.0 = fully decayed)
-        float remainingFactor = 1.0f - juce::jlimit(0.0f, 1.0f, 
-            (float)(timeSinceLastXMovement - decayDelayMs) / (float)ccDecayDurationMs);
+        // Each CC has its own curve over the Y position - one table lookup each
+        // Send CC1 (Modulation Wheel) if enabled
+        if (modulationEnabled)
+            sendModulationCC(curves.getTable(ResponseCurveSet::modulationCurve).apply(yValue), captureTicks);
         
-        cc1Value = (int)(lastModulationValue * remainingFactor);
-        cc11Value = (int)(lastExpressionValue * remainingFactor);
-        
-        // If decay is complete, ensure values are actually 0
-        if (remainingFactor <= 0.0f)
-        {
-            cc1Value = 0;
-            cc11Value = 0;
-        }
-    }
-    else
-    {
-        // Keep last values briefly during delay period
-        cc1Value = lastModulationValue;
-        cc11Value = lastExpressionValue;
-    }
-    
-    // Send CC1 (Modulation Wheel) if enabled
-    if (modulationEnabled)
-    {
-        // Only send if value changed significantly
-        if (std::abs(cc1Value - lastModulationValue) >= 1)
-        {
-            sendModulationCC(cc1Value);
-            lastModulationValue = cc1Value;
-        }
-    }
-    
-    // Send CC11 (Expression) with its own value if enabled
-    if (expressionEnabled)
-    {
-        // Only send if value changed significantly
-        if (std::abs(cc11Value - lastExpressionValue) >= 1)
-        {
-            sendExpressionCC(cc11Value);
-            lastExpressionValue = cc11Value;
-        }
+        // Send CC11 (Expression) if enabled
+        if (expressionEnabled)
+            sendExpressionCC(curves.getTable(ResponseCurveSet::expressionCurve).apply(yValue), captureTicks);
     }
     
     // Update tracking variables
     lastMousePosition = currentMousePosition;
-    lastMouseTime = currentTime;
 }
 
 int MouseMidiExpression::calculateVelocityFromYPosition(int yPos) const
@@ -190,78 +207,36 @@ int MouseMidiExpression::calculateVelocityFromYPosition(int yPos) const
     return juce::jlimit(0, 127, velocity);
 }
 
-float MouseMidiExpression::calculateXVelocity(const juce::Point<int>& from, 
-                                              const juce::Point<int>& to, 
-                                              juce::int64 timeDelta)
-{
-    // Calculate X distance moved
-    float dx = (float)(to.x - from.x);
-    float distance = std::abs(dx);
-    
-    // Calculate velocity in pixels per second
-    float timeInSeconds = timeDelta / 1000.0f;
-    if (timeInSeconds > 0)
-        return distance / timeInSeconds;
-    
-    return 0.0f;
-}
-
-float MouseMidiExpression::applyCurve(float normalizedValue) const
-{
-    normalizedValue = juce::jlimit(0.0f, 1.0f, normalizedValue);
-    
-    switch (curveType)
-    {
-        case CurveType::Linear:
-            return normalizedValue;
-            
-        case CurveType::Exponential:
-            // Exponential curve: x^2
-            return normalizedValue * normalizedValue;
-            
-        case CurveType::Logarithmic:
-            // Logarithmic curve: approximated with sqrt
-            return std::sqrt(normalizedValue);
-            
-        default:
-            return normalizedValue;
-    }
-}
-
-void MouseMidiExpression::sendModulationCC(int value)
+void MouseMidiExpression::sendModulationCC(int value, juce::int64 timestampTicks)
 {
     value = juce::jlimit(0, 127, value);
     
-    if (onMidiMessage)
+    if (onControllerTarget)
     {
-        // CC1 = Modulation Wheel, using channel 1 (MIDI channels are 1-based in the API)
-        auto message = juce::MidiMessage::controllerEvent(1, 1, value);
+        // CC1 = Modulation Wheel
+        onControllerTarget(1, value, timestampTicks);
         
-        // Debug log to verify message is being created
-        juce::Logger::writeToLog("Sending CC1 (Modulation): value=" + juce::String(value) + 
-                                  " channel=" + juce::String(message.getChannel()) +
-                                  " controller=" + juce::String(message.getControllerNumber()) +
-                                  " controllerValue=" + juce::String(message.getControllerValue()));
-        
-        onMidiMessage(message);
+        // Trace only actual changes - a binary record, no formatting here
+        if (value != lastModulationValue)
+            STRADELLA_TRACE (verbose, modulationTarget, value);
     }
+    
+    lastModulationValue = value;
 }
 
-void MouseMidiExpression::sendExpressionCC(int value)
+void MouseMidiExpression::sendExpressionCC(int value, juce::int64 timestampTicks)
 {
     value = juce::jlimit(0, 127, value);
     
-    if (onMidiMessage)
+    if (onControllerTarget)
     {
-        // CC11 = Expression, using channel 1 (MIDI channels are 1-based in the API)
-        auto message = juce::MidiMessage::controllerEvent(1, 11, value);
+        // CC11 = Expression
+        onControllerTarget(11, value, timestampTicks);
         
-        // Debug log to verify message is being created
-        juce::Logger::writeToLog("Sending CC11 (Expression): value=" + juce::String(value) + 
-                                  " channel=" + juce::String(message.getChannel()) +
-                                  " controller=" + juce::String(message.getControllerNumber()) +
-                                  " controllerValue=" + juce::String(message.getControllerValue()));
-        
-        onMidiMessage(message);
+        // Trace only actual changes - a binary record, no formatting here
+        if (value != lastExpressionValue)
+            STRADELLA_TRACE (verbose, expressionTarget, value);
     }
+    
+    lastExpressionValue = value;
 }
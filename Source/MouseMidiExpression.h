@@ -1,29 +1,28 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "ResponseCurve.h"
+#include "PerformanceCounters.h"
 
 //==============================================================================
 /**
     Handles mouse-based MIDI expression control, emulating accordion bellows.
     - Mouse Y position determines note velocity (127 at top, 0 at bottom)
     - Mouse Y position determines CC1 and CC11 (only when moving in X direction)
-    - CC1 and CC11 decay to 0 when X movement stops
+    - CC1 and CC11 decay to 0 when X movement stops (the processor runs the decay)
     - X direction changes trigger note off/on for all pressed keys
     
     Uses global mouse tracking to monitor movement across the entire desktop.
+    Desktop may only be used on the message thread, so the position is read
+    there at the sampling rate, timestamped as it is read, and published with
+    its timestamp. A busy message thread therefore delays or skips readings,
+    but never shifts their timing. A dedicated high-resolution timer thread
+    picks them up and analyses the movement, so the callbacks below are called
+    on that thread, not the message thread.
 */
-class MouseMidiExpression : private juce::Timer
+class MouseMidiExpression : private juce::HighResolutionTimer
 {
 public:
-    //==============================================================================
-    /** Curve types for mapping mouse movement to MIDI values */
-    enum class CurveType
-    {
-        Linear,
-        Exponential,
-        Logarithmic
-    };
-    
     //==============================================================================
     MouseMidiExpression();
     ~MouseMidiExpression() override;
@@ -34,83 +33,124 @@ public:
     /** Sets whether CC11 (Expression) is enabled */
     void setExpressionEnabled(bool enabled) { expressionEnabled = enabled; }
     
-    /** Sets the curve type for mapping */
-    void setCurveType(CurveType type) { curveType = type; }
-    
     /** Gets the current modulation enabled state */
     bool isModulationEnabled() const { return modulationEnabled; }
     
     /** Gets the current expression enabled state */
     bool isExpressionEnabled() const { return expressionEnabled; }
     
-    /** Gets the current curve type */
-    CurveType getCurveType() const { return curveType; }
+    /** The velocity, CC1 and CC11 response curves (edit on the message thread) */
+    ResponseCurveSet& getResponseCurves() { return curves; }
     
     /** Gets the current note velocity based on mouse Y position (127 at top, 0 at bottom) */
     int getCurrentNoteVelocity() const { return currentNoteVelocity; }
     
-    /** Callback for MIDI message output */
-    std::function<void(const juce::MidiMessage&)> onMidiMessage;
+    /** Sets how often the mouse is sampled (clamped to 250-1000 Hz). Restarts tracking if running. */
+    void setSamplingRateHz(int newRateHz);
+    
+    /** Gets the mouse sampling rate in Hz */
+    int getSamplingRateHz() const { return samplingRateHz; }
+    
+    static constexpr int minSamplingRateHz = 250;
+    static constexpr int maxSamplingRateHz = 1000;
+    
+    /** How long controllers hold after X movement stops, and how long they then take to reach 0 */
+    static constexpr double decayDelaySeconds = 0.1;
+    static constexpr double ccDecayDurationSeconds = 0.2;
+    
+    /** Callback with a new controller target (CC number, value 0-127) and its capture time in
+        high-resolution ticks. Called on the sampling thread for every sample while the bellows move.
+    */
+    std::function<void(int controllerNumber, int value, juce::int64 timestampTicks)> onControllerTarget;
+    
+    /** Callback when X direction changes (bellows direction change). Called on the sampling thread. */
+    std::function<void(juce::int64 timestampTicks)> onDirectionChange;
     
-    /** Callback when X direction changes (bellows direction change) */
-    std::function<void()> onDirectionChange;
+    /** Counts late sampling callbacks into the given counters (set before startTracking) */
+    void setPerformanceCounters(PerformanceCounters* countersToUpdate) { performanceCounters = countersToUpdate; }
     
     /** Starts global mouse tracking */
     void startTracking();
     
-    /** Stops global mouse tracking */
+    /** Stops global mouse tracking. Waits for a running callback to finish. */
     void stopTracking();
 
 private:
     //==============================================================================
-    // Timer callback for polling mouse position
-    void timerCallback() override;
+    /** Reads the mouse position on the message thread and publishes it for the sampling thread */
+    class PositionSampler : private juce::Timer
+    {
+    public:
+        /** A position and the high-resolution tick time it was read at */
+        struct Sample
+        {
+            juce::Point<int> position;
+            juce::int64 ticks = 0;
+        };
+        
+        void start(int intervalMilliseconds);
+        void stop()     { stopTimer(); }
+        
+        /** Reads the position now (message thread) */
+        void update();
+        
+        /** The latest published sample (any thread). Returns false if update() was
+            mid-write every time it looked; try again on the next callback.
+        */
+        bool getLatest(Sample& result) const noexcept;
+
+    private:
+        void timerCallback() override   { update(); }
+        
+        // A sequence lock: odd while update() writes, so readers never mix two samples
+        std::atomic<juce::uint32> sequence { 0 };
+        std::atomic<juce::uint64> packedPosition { 0 };     // x in the high 32 bits, y in the low
+        std::atomic<juce::int64> positionTicks { 0 };
+    };
+    
+    PositionSampler positionSampler;
+    
+    // Timer callback for analysing the published mouse position (sampling thread)
+    void hiResTimerCallback() override;
     
     //==============================================================================
-    bool modulationEnabled = true;      // CC1 enabled by default
-    bool expressionEnabled = true;      // CC11 enabled by default
-    CurveType curveType = CurveType::Linear;
+    // Settings are written by the message thread and read by the sampling thread
+    std::atomic<bool> modulationEnabled { true };       // CC1 enabled by default
+    std::atomic<bool> expressionEnabled { true };       // CC11 enabled by default
+    std::atomic<int> samplingRateHz { 500 };
     
-    int currentNoteVelocity = 0;        // Current velocity based on Y position
+    std::atomic<int> currentNoteVelocity { 0 };         // Current velocity based on Y position
     
-    // Direction tracking
+    ResponseCurveSet curves;
+    
+    // Direction tracking (sampling thread only)
     bool isMovingRight = true;          // Track horizontal direction
     bool wasMovingInLastFrame = false;  // Track if mouse was moving
-    juce::int64 lastXMovementTime = 0;  // Time of last X movement
-    static constexpr juce::int64 decayDelayMs = 100; // Time delay before CC decay starts
-    static constexpr juce::int64 ccDecayDurationMs = 200; // Duration of CC value decay to 0
-    
-    // Velocity scaling constants
-    static constexpr float maxVelocityPixelsPerSecond = 2000.0f;  // Max velocity for normalization
+    juce::int64 lastXMovementTicks = 0; // High-resolution time of last X movement
     
     juce::Point<int> lastMousePosition;
     juce::Point<int> currentMousePosition;
-    juce::int64 lastMouseTime = 0;
     
-    int lastModulationValue = 64;   // Last sent CC1 value (0-127)
-    int lastExpressionValue = 64;   // Last sent CC11 value (0-127)
+    PerformanceCounters* performanceCounters = nullptr;
+    juce::int64 lastCallbackTicks = 0;  // Sampling thread only
+    
+    int lastModulationValue = 0;    // Last published CC1 target (0-127)
+    int lastExpressionValue = 0;    // Last published CC11 target (0-127)
     
     juce::Rectangle<int> screenBounds;
     
     //==============================================================================
     /** Processes mouse movement and generates MIDI messages */
-    void processMouseMovement(const juce::Point<int>& mousePos);
+    void processMouseMovement(const juce::Point<int>& mousePos, juce::int64 captureTicks);
     
-    /** Calculates velocity from mouse Y position (127 at top, 0 at bottom) */
+    /** Calculates the uncurved velocity from mouse Y position (127 at top, 0 at bottom) */
     int calculateVelocityFromYPosition(int yPos) const;
     
-    /** Calculates X movement velocity */
-    float calculateXVelocity(const juce::Point<int>& from, const juce::Point<int>& to, 
-                            juce::int64 timeDelta);
-    
-    /** Applies curve to a normalized value (0.0 to 1.0) */
-    float applyCurve(float normalizedValue) const;
-    
-    /** Sends CC1 (Modulation Wheel) MIDI message */
-    void sendModulationCC(int value);
+    /** Publishes a CC1 (Modulation Wheel) target */
+    void sendModulationCC(int value, juce::int64 timestampTicks);
     
-    /** Sends CC11 (Expression) MIDI message */
-    void sendExpressionCC(int value);
+    /** Publishes a CC11 (Expression) target */
+    void sendExpressionCC(int value, juce::int64 timestampTicks);
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MouseMidiExpression)
 };
@@ -5,11 +5,12 @@ MouseMidiSettingsWindow::MouseMidiSettingsWindow(MouseMidiExpression& midiExpres
     : mouseMidiExpression(midiExpression)
 {
     setupUI();
-    setSize(400, 350);  // Adjusted height for removed slider
+    setSize(400, 560);
 }
 
 MouseMidiSettingsWindow::~MouseMidiSettingsWindow()
 {
+    mouseMidiExpression.getResponseCurves().onCurvesChanged = nullptr;
 }
 
 //==============================================================================
@@ -43,45 +44,57 @@ void MouseMidiSettingsWindow::setupUI()
     };
     addAndMakeVisible(expressionCheckbox);
     
-    // Curve selector
-    curveLabel.setText("Response Curve:", juce::dontSendNotification);
-    addAndMakeVisible(curveLabel);
+    // Response curves: a selector and an editable graph per target
+    curvesLabel.setText("Response Curves:", juce::dontSendNotification);
+    addAndMakeVisible(curvesLabel);
     
-    curveSelector.addItem("Linear", 1);
-    curveSelector.addItem("Exponential", 2);
-    curveSelector.addItem("Logarithmic", 3);
+    auto& curves = mouseMidiExpression.getResponseCurves();
+    const char* const targetNames[] = { "Velocity", "CC1", "CC11" };
     
-    // Set current curve
-    switch (mouseMidiExpression.getCurveType())
+    for (int i = 0; i < ResponseCurveSet::numTargets; ++i)
     {
-        case MouseMidiExpression::CurveType::Linear:
-            curveSelector.setSelectedId(1, juce::dontSendNotification);
-            break;
-        case MouseMidiExpression::CurveType::Exponential:
-            curveSelector.setSelectedId(2, juce::dontSendNotification);
-            break;
-        case MouseMidiExpression::CurveType::Logarithmic:
-            curveSelector.setSelectedId(3, juce::dontSendNotification);
-            break;
+        const auto target = (ResponseCurveSet::Target)i;
+        
+        curveLabels[(size_t)i].setText(targetNames[i], juce::dontSendNotification);
+        curveLabels[(size_t)i].setJustificationType(juce::Justification::centred);
+        addAndMakeVisible(curveLabels[(size_t)i]);
+        
+        // Item IDs are the shape's enum value + 1
+        auto& selector = curveSelectors[(size_t)i];
+        
+        for (auto shape : { ResponseCurve::Shape::Linear, ResponseCurve::Shape::Exponential,
+                            ResponseCurve::Shape::Logarithmic, ResponseCurve::Shape::SCurve,
+                            ResponseCurve::Shape::Custom })
+            selector.addItem(ResponseCurve::getShapeName(shape), (int)shape + 1);
+        
+        selector.onChange = [this, target, &selector]
+        {
+            mouseMidiExpression.getResponseCurves().setShape(target, (ResponseCurve::Shape)(selector.getSelectedId() - 1));
+        };
+        addAndMakeVisible(selector);
+        
+        curveEditors[(size_t)i] = std::make_unique<ResponseCurveEditor>(curves, target);
+        addAndMakeVisible(curveEditors[(size_t)i].get());
     }
     
-    curveSelector.onChange = [this]
+    updateCurveSelectors();
+    
+    // Keep the selectors and graphs in step with edits made by dragging
+    curves.onCurvesChanged = [this] { updateCurveSelectors(); };
+    
+    // Mouse sampling rate (item IDs are the rate in Hz)
+    samplingRateLabel.setText("Sampling Rate:", juce::dontSendNotification);
+    addAndMakeVisible(samplingRateLabel);
+    
+    for (int rateHz : { 250, 500, 1000 })
+        samplingRateSelector.addItem(juce::String(rateHz) + " Hz", rateHz);
+    
+    samplingRateSelector.setSelectedId(mouseMidiExpression.getSamplingRateHz(), juce::dontSendNotification);
+    samplingRateSelector.onChange = [this]
     {
-        int selectedId = curveSelector.getSelectedId();
-        switch (selectedId)
-        {
-            case 1:
-                mouseMidiExpression.setCurveType(MouseMidiExpression::CurveType::Linear);
-                break;
-            case 2:
-                mouseMidiExpression.setCurveType(MouseMidiExpression::CurveType::Exponential);
-                break;
-            case 3:
-                mouseMidiExpression.setCurveType(MouseMidiExpression::CurveType::Logarithmic);
-                break;
-        }
+        mouseMidiExpression.setSamplingRateHz(samplingRateSelector.getSelectedId());
     };
-    addAndMakeVisible(curveSelector);
+    addAndMakeVisible(samplingRateSelector);
     
     // Close button
     closeButton.setButtonText("Close");
@@ -93,6 +106,18 @@ void MouseMidiSettingsWindow::setupUI()
     addAndMakeVisible(closeButton);
 }
 
+void MouseMidiSettingsWindow::updateCurveSelectors()
+{
+    auto& curves = mouseMidiExpression.getResponseCurves();
+    
+    for (int i = 0; i < ResponseCurveSet::numTargets; ++i)
+    {
+        const auto shape = curves.getShape((ResponseCurveSet::Target)i);
+        curveSelectors[(size_t)i].setSelectedId((int)shape + 1, juce::dontSendNotification);
+        curveEditors[(size_t)i]->repaint();
+    }
+}
+
 void MouseMidiSettingsWindow::paint(juce::Graphics& g)
 {
     // Fill background
@@ -115,11 +140,14 @@ void MouseMidiSettingsWindow::paint(juce::Graphics& g)
         "  horizontal movement stops.\n\n"
         "Direction Change: Moving left<->right retriggers notes\n"
         "  to emulate accordion bellows direction change.\n\n"
-        "Curve affects how values respond to Y position.\n"
-        "Mouse tracking is global across entire desktop.";
+        "Curves shape how each value responds to Y position.\n"
+        "Drag a curve's points to draw a custom curve.\n"
+        "Mouse tracking is global across entire desktop. The cursor\n"
+        "is read on the UI thread at the selected rate, and each\n"
+        "reading keeps the time it was taken.";
     
     auto infoArea = getLocalBounds().reduced(20);
-    infoArea.removeFromTop(200);  // Adjusted for removed slider
+    infoArea.removeFromTop(330);
     
     g.drawMultiLineText(infoText, infoArea.getX(), infoArea.getY(), 
                         infoArea.getWidth(), juce::Justification::left);
@@ -145,11 +173,27 @@ void MouseMidiSettingsWindow::resized()
     expressionLabel.setBounds(expressionArea);
     area.removeFromTop(10);
     
-    // Curve selector
-    auto curveArea = area.removeFromTop(25);
-    curveLabel.setBounds(curveArea.removeFromLeft(120));
-    curveSelector.setBounds(curveArea.reduced(5, 0));
-    area.removeFromTop(20);  // Extra space before button
+    // Sampling rate selector
+    auto samplingRateArea = area.removeFromTop(25);
+    samplingRateLabel.setBounds(samplingRateArea.removeFromLeft(120));
+    samplingRateSelector.setBounds(samplingRateArea.reduced(5, 0));
+    area.removeFromTop(10);
+    
+    // Response curves, three columns
+    curvesLabel.setBounds(area.removeFromTop(20));
+    
+    auto curvesArea = area.removeFromTop(155);
+    const int columnWidth = curvesArea.getWidth() / ResponseCurveSet::numTargets;
+    
+    for (size_t i = 0; i < (size_t)ResponseCurveSet::numTargets; ++i)
+    {
+        auto column = curvesArea.removeFromLeft(columnWidth).reduced(3, 0);
+        curveLabels[i].setBounds(column.removeFromTop(20));
+        curveSelectors[i].setBounds(column.removeFromTop(25));
+        column.removeFromTop(5);
+        curveEditors[i]->setBounds(column.withSizeKeepingCentre(juce::jmin(column.getWidth(), column.getHeight()),
+                                                                juce::jmin(column.getWidth(), column.getHeight())));
+    }
     
     // Close button at bottom
     auto buttonArea = getLocalBounds().reduced(20);
@@ -2,11 +2,13 @@
 
 #include <JuceHeader.h>
 #include "MouseMidiExpression.h"
+#include "ResponseCurveEditor.h"
 
 //==============================================================================
 /**
     Settings window for configuring mouse MIDI expression behavior.
-    Allows user to enable/disable CC1 and CC11, and select curve type.
+    Allows user to enable/disable CC1 and CC11, and select or draw the
+    response curves for note velocity, CC1 and CC11.
 */
 class MouseMidiSettingsWindow : public juce::Component
 {
@@ -31,13 +33,20 @@ private:
     juce::ToggleButton expressionCheckbox;
     juce::Label expressionLabel;
     
-    juce::ComboBox curveSelector;
-    juce::Label curveLabel;
+    // One curve selector and editor each for velocity, CC1 and CC11
+    juce::Label curvesLabel;
+    std::array<juce::Label, ResponseCurveSet::numTargets> curveLabels;
+    std::array<juce::ComboBox, ResponseCurveSet::numTargets> curveSelectors;
+    std::array<std::unique_ptr<ResponseCurveEditor>, ResponseCurveSet::numTargets> curveEditors;
+    
+    juce::ComboBox samplingRateSelector;
+    juce::Label samplingRateLabel;
     
     juce::TextButton closeButton;
     
     //==============================================================================
     void setupUI();
+    void updateCurveSelectors();
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MouseMidiSettingsWindow)
 };
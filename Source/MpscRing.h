@@ -0,0 +1,98 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Bounded lock-free multi-producer/single-consumer ring of fixed-size items.
+    
+    Each slot carries a sequence number that says whether it is free or full
+    for the current lap, so producers claim slots with one compare-exchange on
+    the write position and the consumer needs no atomic read-modify-write at
+    all. Pushing never locks, allocates or waits: a failed claim (another
+    producer got there first, or a spurious failure) retries with the updated
+    position, and when the ring is full the item is dropped and counted.
+*/
+template <typename Item, int capacity>
+class MpscRing
+{
+public:
+    static_assert ((capacity & (capacity - 1)) == 0, "Ring capacity must be a power of two");
+    static_assert (std::is_trivially_copyable<Item>::value, "Items are copied in and out of the slots");
+    
+    MpscRing() noexcept
+    {
+        for (size_t i = 0; i < slots.size(); ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    
+    /** Copies an item into the ring. Returns false if it was dropped. Any thread. */
+    bool push(const Item& item) noexcept
+    {
+        auto position = writePosition.load(std::memory_order_relaxed);
+        
+        for (;;)
+        {
+            auto& slot = slots[(size_t)(position & (capacity - 1))];
+            const auto sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto difference = (juce::int64)(sequence - position);
+            
+            if (difference == 0)
+            {
+                // The slot is free for this lap - claim it. On failure position is reloaded.
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    slot.item = item;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                // Full - the consumer is behind, so drop rather than wait
+                droppedItems.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+    
+    /** Calls the callback for every published item in order, then frees their slots. Consumer only. */
+    template <typename Callback>
+    void drain(Callback&& callback)
+    {
+        for (;;)
+        {
+            auto& slot = slots[(size_t)(readPosition & (capacity - 1))];
+            
+            if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+                break; // Nothing more has been published
+            
+            const auto item = slot.item;
+            slot.sequence.store(readPosition + capacity, std::memory_order_release);
+            ++readPosition;
+            
+            callback(item);
+        }
+    }
+    
+    /** Number of items lost because the ring was full */
+    juce::uint64 getNumDroppedItems() const noexcept { return droppedItems.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        std::atomic<juce::uint64> sequence { 0 };
+        Item item {};
+    };
+    
+    std::array<Slot, (size_t)capacity> slots;
+    std::atomic<juce::uint64> writePosition { 0 };
+    juce::uint64 readPosition = 0;                      // Consumer only
+    std::atomic<juce::uint64> droppedItems { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE (MpscRing)
+};
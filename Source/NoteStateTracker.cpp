@@ -0,0 +1,125 @@
+#include "NoteStateTracker.h"
+
+//==============================================================================
+void NoteStateTracker::processEvent(const MidiEventFifo::Event& event, int sampleOffset, juce::MidiBuffer& output) noexcept
+{
+    if ((event.flags & MidiEventFifo::bellowsReversalFlag) != 0)
+    {
+        reverseBellows(event.data[0], sampleOffset, output);
+        return;
+    }
+    
+    const int status = event.data[0] & 0xf0;
+    const bool isNoteOn = status == 0x90 && event.size >= 3 && event.data[2] > 0;
+    const bool isNoteOff = (status == 0x80 || status == 0x90) && event.size >= 3 && !isNoteOn;
+    
+    // Anything that isn't a note passes straight through
+    if (!isNoteOn && !isNoteOff)
+    {
+        output.addEvent(event.data, (int)event.size, sampleOffset);
+        return;
+    }
+    
+    const int channelIndex = event.data[0] & 0x0f;
+    const int noteNumber = event.data[1] & 0x7f;
+    auto& count = referenceCounts[(size_t)channelIndex][(size_t)noteNumber];
+    
+    if (isNoteOn)
+    {
+        const juce::uint8 velocity = event.data[2];
+        
+        if (count == 0)
+        {
+            setSounding(channelIndex, noteNumber, true);
+            addNoteOn(output, channelIndex, noteNumber, velocity, sampleOffset);
+        }
+        else if (getRetriggerPolicy() == RetriggerPolicy::RetriggerRepeatedNoteOn)
+        {
+            addNoteOff(output, channelIndex, noteNumber, sampleOffset);
+            addNoteOn(output, channelIndex, noteNumber, velocity, sampleOffset);
+        }
+        
+        if (count < 255)
+            ++count;
+    }
+    else
+    {
+        // A note-off for a note that isn't sounding is dropped
+        if (count == 0)
+            return;
+        
+        if (--count == 0)
+        {
+            setSounding(channelIndex, noteNumber, false);
+            addNoteOff(output, channelIndex, noteNumber, sampleOffset);
+        }
+    }
+}
+
+bool NoteStateTracker::isNoteSounding(int channel, int noteNumber) const noexcept
+{
+    return getNoteReferenceCount(channel, noteNumber) > 0;
+}
+
+int NoteStateTracker::getNoteReferenceCount(int channel, int noteNumber) const noexcept
+{
+    if (!juce::isPositiveAndBelow(channel - 1, numChannels) || !juce::isPositiveAndBelow(noteNumber, numNotes))
+        return 0;
+    
+    return referenceCounts[(size_t)(channel - 1)][(size_t)noteNumber];
+}
+
+void NoteStateTracker::setSounding(int channelIndex, int noteNumber, bool isSounding) noexcept
+{
+    auto& word = soundingNotes[(size_t)channelIndex][(size_t)(noteNumber / 64)];
+    const auto bit = (juce::uint64)1 << (noteNumber % 64);
+    
+    if (isSounding)
+        word |= bit;
+    else
+        word &= ~bit;
+}
+
+void NoteStateTracker::reverseBellows(juce::uint8 velocity, int sampleOffset, juce::MidiBuffer& output) const noexcept
+{
+    // Each sounding note appears once in the bitsets however many keys hold it.
+    // All offs go first, then all ons - MidiBuffer keeps insertion order within a
+    // sample, so nothing can re-sound before the whole chord has been released.
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (int channelIndex = 0; channelIndex < numChannels; ++channelIndex)
+        {
+            for (int wordIndex = 0; wordIndex < numNotes / 64; ++wordIndex)
+            {
+                // Empty words (the common case) are skipped without looking at their bits
+                auto word = soundingNotes[(size_t)channelIndex][(size_t)wordIndex];
+                
+                for (int bit = 0; word != 0; ++bit, word >>= 1)
+                {
+                    if ((word & 1) == 0)
+                        continue;
+                    
+                    const int noteNumber = wordIndex * 64 + bit;
+                    
+                    if (pass == 0)
+                        addNoteOff(output, channelIndex, noteNumber, sampleOffset);
+                    else
+                        addNoteOn(output, channelIndex, noteNumber, velocity, sampleOffset);
+                }
+            }
+        }
+    }
+}
+
+void NoteStateTracker::addNoteOn(juce::MidiBuffer& output, int channelIndex, int noteNumber,
+                                 juce::uint8 velocity, int sampleOffset) noexcept
+{
+    const juce::uint8 data[] = { (juce::uint8)(0x90 | channelIndex), (juce::uint8)noteNumber, velocity };
+    output.addEvent(data, 3, sampleOffset);
+}
+
+void NoteStateTracker::addNoteOff(juce::MidiBuffer& output, int channelIndex, int noteNumber, int sampleOffset) noexcept
+{
+    const juce::uint8 data[] = { (juce::uint8)(0x80 | channelIndex), (juce::uint8)noteNumber, 0 };
+    output.addEvent(data, 3, sampleOffset);
+}
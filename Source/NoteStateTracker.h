@@ -0,0 +1,62 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MidiEventFifo.h"
+
+//==============================================================================
+/**
+    Reference-counts sounding notes per MIDI channel so that several keys can
+    share a note without stepping on each other.
+    
+    Only the first note-on and the last note-off for a note reach the output.
+    A note-on for a note that is already sounding is either absorbed or turned
+    into an explicit retrigger (note-off then note-on), depending on the
+    retrigger policy. A bellows reversal command re-articulates every sounding
+    note exactly once and never changes the counts.
+    
+    processEvent() is audio thread only. The state is kept for the processor's
+    lifetime, across prepareToPlay, so no note-off is ever lost to a reset.
+*/
+class NoteStateTracker
+{
+public:
+    enum class RetriggerPolicy
+    {
+        IgnoreRepeatedNoteOn,       // Extra keys holding a sounding note are silent
+        RetriggerRepeatedNoteOn     // Extra keys re-articulate the sounding note
+    };
+    
+    static constexpr int numChannels = 16;
+    static constexpr int numNotes = 128;
+    
+    //==============================================================================
+    NoteStateTracker() = default;
+    
+    /** Sets how repeated note-ons are handled (any thread) */
+    void setRetriggerPolicy(RetriggerPolicy newPolicy) noexcept { policy.store(newPolicy, std::memory_order_relaxed); }
+    RetriggerPolicy getRetriggerPolicy() const noexcept        { return policy.load(std::memory_order_relaxed); }
+    
+    /** Filters one event and writes whatever should actually be sent to the output */
+    void processEvent(const MidiEventFifo::Event& event, int sampleOffset, juce::MidiBuffer& output) noexcept;
+    
+    /** Returns true if at least one key holds the note (channel is 1-16) */
+    bool isNoteSounding(int channel, int noteNumber) const noexcept;
+    
+    /** Gets how many keys currently hold the note (channel is 1-16) */
+    int getNoteReferenceCount(int channel, int noteNumber) const noexcept;
+
+private:
+    // Per channel: reference count per note, plus a bitset of the sounding notes
+    std::array<std::array<juce::uint8, numNotes>, numChannels> referenceCounts {};
+    std::array<std::array<juce::uint64, numNotes / 64>, numChannels> soundingNotes {};
+    
+    std::atomic<RetriggerPolicy> policy { RetriggerPolicy::IgnoreRepeatedNoteOn };
+    
+    void setSounding(int channelIndex, int noteNumber, bool isSounding) noexcept;
+    void reverseBellows(juce::uint8 velocity, int sampleOffset, juce::MidiBuffer& output) const noexcept;
+    
+    static void addNoteOn(juce::MidiBuffer& output, int channelIndex, int noteNumber, juce::uint8 velocity, int sampleOffset) noexcept;
+    static void addNoteOff(juce::MidiBuffer& output, int channelIndex, int noteNumber, int sampleOffset) noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NoteStateTracker)
+};
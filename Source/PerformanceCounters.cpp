@@ -0,0 +1,189 @@
+#include "PerformanceCounters.h"
+
+//==============================================================================
+namespace
+{
+    /** Stats files owned by instances in this process. Their locks can't be probed from here -
+        the OS would hand them to us again - so the cleanup skips them by name. */
+    struct OwnedStatsFiles
+    {
+        juce::CriticalSection lock;
+        juce::StringArray fileNames;
+    };
+    
+    OwnedStatsFiles& getOwnedStatsFiles()
+    {
+        static OwnedStatsFiles ownedFiles;
+        return ownedFiles;
+    }
+    
+    juce::String getOwnerLockName(const juce::File& statsFile)
+    {
+        return "straDellaMIDI-stats-" + statsFile.getFileNameWithoutExtension();
+    }
+}
+
+//==============================================================================
+PerformanceCounters::PerformanceCounters()
+{
+    const auto directory = getStatsDirectory();
+    
+    if (directory.createDirectory().wasOk())
+    {
+        const juce::ScopedLock sl(getOwnedStatsFiles().lock);
+        
+        removeStaleStatsFiles(directory);
+        statsFile = claimStatsFile(directory);
+    }
+    
+    if (statsFile != juce::File())
+    {
+        // Size the file first - a mapping can't grow it
+        juce::MemoryBlock zeros(sizeof(Page), true);
+        
+        if (statsFile.replaceWithData(zeros.getData(), zeros.getSize()))
+        {
+            mappedFile = std::make_unique<juce::MemoryMappedFile>(statsFile, juce::MemoryMappedFile::readWrite);
+            
+            if (mappedFile->getData() == nullptr || mappedFile->getSize() < sizeof(Page))
+                mappedFile.reset();
+        }
+    }
+    
+    if (mappedFile != nullptr)
+    {
+        page = new (mappedFile->getData()) Page();
+    }
+    else
+    {
+        releaseStatsFile();
+        fallbackPage = std::make_unique<Page>();
+        page = fallbackPage.get();
+    }
+    
+    initialiseHeader(*page);
+}
+
+PerformanceCounters::~PerformanceCounters()
+{
+    mappedFile.reset();
+    releaseStatsFile();
+}
+
+//==============================================================================
+juce::File PerformanceCounters::claimStatsFile(const juce::File& directory)
+{
+    for (int number = 1; number <= 1000; ++number)
+    {
+        const auto file = directory.getChildFile("instance" + juce::String(number) + ".stats");
+        
+        // Stale files are gone by now, so an existing one belongs to a running instance
+        if (file.exists())
+            continue;
+        
+        // Another process may be claiming the same name right now - the lock decides
+        auto lock = std::make_unique<juce::InterProcessLock>(getOwnerLockName(file));
+        
+        if (!lock->enter(0))
+            continue;
+        
+        ownerLock = std::move(lock);
+        getOwnedStatsFiles().fileNames.add(file.getFileName());
+        return file;
+    }
+    
+    return {};
+}
+
+void PerformanceCounters::releaseStatsFile()
+{
+    if (ownerLock == nullptr)
+        return;
+    
+    // Delete the file before dropping the lock, so nobody sees it unowned
+    statsFile.deleteFile();
+    
+    auto& ownedFiles = getOwnedStatsFiles();
+    const juce::ScopedLock sl(ownedFiles.lock);
+    ownedFiles.fileNames.removeString(statsFile.getFileName());
+    ownerLock.reset();
+    statsFile = juce::File();
+}
+
+void PerformanceCounters::removeStaleStatsFiles(const juce::File& directory)
+{
+    const auto& ownedFileNames = getOwnedStatsFiles().fileNames;
+    
+    for (const auto& file : directory.findChildFiles(juce::File::findFiles, false, "*.stats"))
+    {
+        if (ownedFileNames.contains(file.getFileName()))
+            continue;
+        
+        // Nobody holds the lock: the instance that wrote this file is gone
+        juce::InterProcessLock lock(getOwnerLockName(file));
+        
+        if (lock.enter(0))
+            file.deleteFile();
+    }
+}
+
+bool PerformanceCounters::isStatsFileInUse(const juce::File& file)
+{
+    juce::InterProcessLock lock(getOwnerLockName(file));
+    return !lock.enter(0);
+}
+
+//==============================================================================
+juce::File PerformanceCounters::getStatsDirectory()
+{
+    return juce::File::getSpecialLocation(juce::File::tempDirectory).getChildFile("straDellaMIDI-stats");
+}
+
+const char* PerformanceCounters::getCounterName(Counter counter) noexcept
+{
+    switch (counter)
+    {
+        case Counter::eventsEnqueued:               return "events enqueued";
+        case Counter::eventsDropped:                return "events dropped";
+        case Counter::eventsCoalesced:              return "events coalesced";
+        case Counter::blocksProcessed:              return "blocks processed";
+        case Counter::blocksWithEvents:             return "blocks with events";
+        case Counter::maxEventsPerBlock:            return "max events per block";
+        case Counter::queueHighWaterMark:           return "queue high-water mark";
+        case Counter::guiFramesSkipped:             return "GUI frames skipped";
+        case Counter::timerOverruns:                return "timer overruns";
+        case Counter::outputControllersCoalesced:   return "output CCs coalesced";
+        case Counter::outputNoteOnsDropped:         return "output note-ons dropped";
+        case Counter::outputBudgetExceeded:         return "output budget exceeded";
+        case Counter::outputBufferGrown:            return "output buffer grown";
+        case Counter::numCounters:                  break;
+    }
+    
+    return "";
+}
+
+bool PerformanceCounters::isValidPage(const void* data, size_t size) noexcept
+{
+    if (data == nullptr || size < sizeof(Page))
+        return false;
+    
+    const auto& header = *static_cast<const Page*>(data);
+    
+    return std::memcmp(header.magic, "STRDPERF", sizeof(header.magic)) == 0
+        && header.version == pageVersion
+        && header.numCounters == (juce::uint32)numCounters;
+}
+
+void PerformanceCounters::initialiseHeader(Page& pageToInitialise) noexcept
+{
+    pageToInitialise.version = pageVersion;
+    pageToInitialise.numCounters = (juce::uint32)numCounters;
+    pageToInitialise.startTimeMillis = juce::Time::currentTimeMillis();
+    
+    for (auto& counter : pageToInitialise.counters)
+        counter.store(0, std::memory_order_relaxed);
+    
+    // Magic last, so a reader never accepts a half-written header
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(pageToInitialise.magic, "STRDPERF", sizeof(pageToInitialise.magic));
+}
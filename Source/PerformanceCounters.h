@@ -0,0 +1,114 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Cheap atomic performance counters, published in a memory-mapped stats file
+    per plugin instance so an external tool can watch them live.
+    
+    The file is a fixed Page: a small header followed by one 64-bit counter per
+    Counter id. Updates are single relaxed atomic operations on the mapped page -
+    no locks, no system calls - so the audio thread can update them every block.
+    If the file can't be created, the counters still work in process memory.
+    
+    Each instance holds an inter-process lock named after its file for as long
+    as the file exists. The OS drops the lock when a process dies, so a file
+    whose lock can be taken was left behind by a crash: new instances delete
+    those before creating their own, and the reader skips them.
+    
+    The layout is shared with the bundled reader (Tools/PerformanceCounterReader.cpp):
+    bump pageVersion whenever it changes.
+*/
+class PerformanceCounters
+{
+public:
+    enum class Counter
+    {
+        eventsEnqueued,                 // Editor events accepted by the processor's input queue
+        eventsDropped,                  // Editor events lost to a full input queue or jitter buffer
+        eventsCoalesced,                // Controller values superseded before a block used them
+        blocksProcessed,
+        blocksWithEvents,               // Blocks that sent at least one event to the host
+        maxEventsPerBlock,
+        queueHighWaterMark,             // Most events waiting in the input queue at the start of a block
+        guiFramesSkipped,               // Display frames the editor's frame update missed
+        timerOverruns,                  // Expression sampling callbacks that came later than 1.5 periods
+        outputControllersCoalesced,     // Over the output budget: controller values replaced by a later one in the block
+        outputNoteOnsDropped,           // Over the output budget: note-ons switched off again in the same block
+        outputBudgetExceeded,           // Blocks still written over the output budget after the overflow policy ran
+        outputBufferGrown,              // Blocks where the host's MIDI buffer was smaller than the budget and had to grow
+        numCounters
+    };
+    
+    static constexpr int numCounters = (int)Counter::numCounters;
+    static constexpr juce::uint32 pageVersion = 3;
+    
+    /** The mapped layout */
+    struct Page
+    {
+        char magic[8];                      // "STRDPERF"
+        juce::uint32 version;
+        juce::uint32 numCounters;
+        juce::int64 startTimeMillis;        // Wall-clock time the instance was created
+        std::array<std::atomic<juce::uint64>, (size_t)PerformanceCounters::numCounters> counters;
+    };
+    
+    static_assert (std::atomic<juce::uint64>::is_always_lock_free,
+                   "Counters shared with another process must be lock-free");
+    
+    //==============================================================================
+    /** Removes stale stats files, then creates and maps a new one in getStatsDirectory() */
+    PerformanceCounters();
+    
+    /** Unmaps and deletes the stats file */
+    ~PerformanceCounters();
+    
+    void add(Counter counter, juce::uint64 amount = 1) noexcept
+    {
+        getCounter(counter).fetch_add(amount, std::memory_order_relaxed);
+    }
+    
+    /** Raises a high-water counter to value if it is larger (single writer per counter) */
+    void updateMax(Counter counter, juce::uint64 value) noexcept
+    {
+        auto& target = getCounter(counter);
+        
+        if (value > target.load(std::memory_order_relaxed))
+            target.store(value, std::memory_order_relaxed);
+    }
+    
+    juce::uint64 get(Counter counter) const noexcept { return page->counters[(size_t)counter].load(std::memory_order_relaxed); }
+    
+    /** The mapped file, or {} if the counters only live in memory */
+    juce::File getStatsFile() const { return mappedFile != nullptr ? statsFile : juce::File(); }
+    
+    /** Where each instance's stats file is created */
+    static juce::File getStatsDirectory();
+    
+    static const char* getCounterName(Counter counter) noexcept;
+    
+    /** Checks a mapped page's header before reading its counters */
+    static bool isValidPage(const void* data, size_t size) noexcept;
+    
+    /** True if a running instance owns the file. Only meaningful from another process -
+        the OS lets a process take its own locks again. */
+    static bool isStatsFileInUse(const juce::File& file);
+
+private:
+    juce::File statsFile;
+    std::unique_ptr<juce::InterProcessLock> ownerLock;     // Held while statsFile exists
+    std::unique_ptr<juce::MemoryMappedFile> mappedFile;
+    std::unique_ptr<Page> fallbackPage;
+    Page* page = nullptr;
+    
+    std::atomic<juce::uint64>& getCounter(Counter counter) noexcept { return page->counters[(size_t)counter]; }
+    
+    juce::File claimStatsFile(const juce::File& directory);
+    void releaseStatsFile();
+    
+    static void removeStaleStatsFiles(const juce::File& directory);
+    static void initialiseHeader(Page& pageToInitialise) noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PerformanceCounters)
+};
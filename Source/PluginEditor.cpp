@@ -20,29 +20,46 @@ StraDellaMIDIAudioProcessorEditor::StraDellaMIDIAudioProcessorEditor (StraDellaM
     midiDisplay = std::make_unique<MIDIMessageDisplay>();
     addAndMakeVisible(midiDisplay.get());
     
+    // The MIDI log shows what processBlock actually sends to the host
+    frameScheduler = std::make_unique<GuiFrameScheduler>(*this, audioProcessor.getKeyState(), audioProcessor.getEmittedEvents(),
+                                                         *keyboardGUI, *midiDisplay, audioProcessor.getPerformanceCounters());
+    audioProcessor.setOutputMonitoringEnabled(true);
+    
+    latencyOverlay = std::make_unique<LatencyOverlay>(audioProcessor.getLatencyStats());
+    addChildComponent(latencyOverlay.get());
+    
     // Create mouse MIDI expression component (no visual component needed)
     mouseMidiExpression = std::make_unique<MouseMidiExpression>();
-    mouseMidiExpression->onMidiMessage = [this](const juce::MidiMessage& msg)
+    // The expression callbacks run on its sampling thread: they only touch the processor's atomics
+    mouseMidiExpression->onControllerTarget = [this](int controllerNumber, int value, juce::int64 timestampTicks)
     {
-        sendMidiMessage(msg);
-        
-        // Display CC messages in MIDI log
-        juce::MessageManager::callAsync([this, msg]()
+        // The processor renders the controller ramps and decay from these targets
+        if (!audioProcessor.setControllerTarget(controllerNumber, value, timestampTicks))
         {
-            if (midiDisplay != nullptr)
-                midiDisplay->addMidiMessage(msg);
-        });
+            jassertfalse; // Only generated controllers may come from the sampling thread
+        }
     };
     
+    // Controllers hold briefly after the bellows stop, then fall to zero
+    audioProcessor.setControllerDecay(MouseMidiExpression::decayDelaySeconds, MouseMidiExpression::ccDecayDurationSeconds);
+    
     // Handle direction changes (bellows direction change)
-    mouseMidiExpression->onDirectionChange = [this]()
+    mouseMidiExpression->onDirectionChange = [this](juce::int64 timestampTicks)
     {
-        retriggerCurrentlyPressedKeys();
+        retriggerCurrentlyPressedKeys(timestampTicks);
     };
     
     // Start global mouse tracking
+    mouseMidiExpression->setPerformanceCounters(&audioProcessor.getPerformanceCounters());
     mouseMidiExpression->startTracking();
     
+    // Refresh key labels when the mapping file is reloaded or the layout is transposed
+    audioProcessor.getKeyboardMapper().onLayoutChanged = [this]()
+    {
+        if (keyboardGUI != nullptr)
+            keyboardGUI->refreshKeyMappings();
+    };
+    
     // Create mouse settings window (initially hidden)
     mouseSettingsWindow = std::make_unique<MouseMidiSettingsWindow>(*mouseMidiExpression);
     mouseSettingsWindow->setVisible(false);
@@ -74,8 +91,16 @@ StraDellaMIDIAudioProcessorEditor::StraDellaMIDIAudioProcessorEditor (StraDellaM
 
 StraDellaMIDIAudioProcessorEditor::~StraDellaMIDIAudioProcessorEditor()
 {
+    // Stop the sampling thread first - its callbacks refer to this editor
+    mouseMidiExpression->stopTracking();
+    audioProcessor.setOutputMonitoringEnabled(false);
+    frameScheduler = nullptr;
+    
     // Remove key listener
     removeKeyListener(this);
+    
+    // The mapper outlives the editor
+    audioProcessor.getKeyboardMapper().onLayoutChanged = nullptr;
 }
 
 //==============================================================================
@@ -103,10 +128,14 @@ void StraDellaMIDIAudioProcessorEditor::resized()
     buttonArea.removeFromLeft(buttonSpacing);
     expressionSettingsButton.setBounds(buttonArea.removeFromLeft(buttonWidth).reduced(2));
     
-    // MIDI display at the bottom (above buttons)
+    // MIDI display at the bottom (above buttons), sharing its row with the latency overlay
     if (midiDisplay != nullptr)
     {
         auto midiArea = area.removeFromBottom(150);
+        
+        if (latencyOverlay != nullptr && latencyOverlay->isVisible())
+            latencyOverlay->setBounds(midiArea.removeFromRight(latencyOverlay->getWidth()));
+        
         midiDisplay->setBounds(midiArea);
     }
     
@@ -119,7 +148,7 @@ void StraDellaMIDIAudioProcessorEditor::resized()
     // Position settings window in center (when visible)
     if (mouseSettingsWindow != nullptr && mouseSettingsWindow->isVisible())
     {
-        mouseSettingsWindow->centreWithSize(400, 350);
+        mouseSettingsWindow->centreWithSize(mouseSettingsWindow->getWidth(), mouseSettingsWindow->getHeight());
     }
 }
 
@@ -135,19 +164,19 @@ void StraDellaMIDIAudioProcessorEditor::visibilityChanged()
 
 bool StraDellaMIDIAudioProcessorEditor::keyPressed(const juce::KeyPress& key, juce::Component* originatingComponent)
 {
+    // Stamp the event as early as possible so the processor can place it sample-accurately
+    const auto timestampTicks = juce::Time::getHighResolutionTicks();
+    
     int keyCode = key.getKeyCode();
     
     // Convert to uppercase for letter keys
     if (keyCode >= 'a' && keyCode <= 'z')
         keyCode = keyCode - 'a' + 'A';
     
-    auto& currentlyPressedKeys = audioProcessor.getCurrentlyPressedKeys();
-    
-    // Check if this key is already pressed to avoid OS key repeat
-    if (!currentlyPressedKeys.contains(keyCode))
+    // Only the first press counts - press() returns false for OS key repeats
+    if (audioProcessor.getKeyState().press(keyCode))
     {
-        handleKeyPress(keyCode);
-        currentlyPressedKeys.add(keyCode);
+        handleKeyPress(keyCode, timestampTicks);
         return true;
     }
     
@@ -161,38 +190,42 @@ bool StraDellaMIDIAudioProcessorEditor::keyStateChanged(bool isKeyDown, juce::Co
     // Handle key releases
     if (!isKeyDown)
     {
-        auto& currentlyPressedKeys = audioProcessor.getCurrentlyPressedKeys();
+        const auto timestampTicks = juce::Time::getHighResolutionTicks();
         
-        // Check which keys were released
-        for (int i = currentlyPressedKeys.size() - 1; i >= 0; --i)
+        auto& keyState = audioProcessor.getKeyState();
+        const auto heldKeys = keyState.snapshot();
+        
+        // Ask the OS only about the keys we believe are held, then diff the two sets
+        KeyStateSet::Snapshot stillDown;
+        
+        heldKeys.forEach([&stillDown](int keyCode)
         {
-            int keyCode = currentlyPressedKeys[i];
-            
-            // Check if the key is still down
-            bool stillDown = false;
-            
-            // Check common keys (simplified check)
             if (juce::KeyPress::isKeyCurrentlyDown(keyCode))
-                stillDown = true;
-            
-            if (!stillDown)
-            {
-                handleKeyRelease(keyCode);
-                currentlyPressedKeys.remove(i);
-            }
-        }
+                stillDown.add(keyCode);
+        });
+        
+        heldKeys.without(stillDown).forEach([this, &keyState, timestampTicks](int keyCode)
+        {
+            keyState.release(keyCode);
+            handleKeyRelease(keyCode, timestampTicks);
+        });
     }
     
     return false;
 }
 
-void StraDellaMIDIAudioProcessorEditor::handleKeyPress(int keyCode)
+void StraDellaMIDIAudioProcessorEditor::handleKeyPress(int keyCode, juce::int64 timestampTicks)
 {
-    bool isValidKey = false;
-    auto midiNotes = audioProcessor.getKeyboardMapper().getMidiNotesForKey(keyCode, isValidKey);
+    // A copy from the mapper's lookup table - no allocation on the press path
+    const auto midiNotes = audioProcessor.getKeyboardMapper().getMidiNotesForKey(keyCode);
+    const auto lookupTicks = juce::Time::getHighResolutionTicks();
     
-    if (isValidKey && !midiNotes.isEmpty())
+    if (!midiNotes.isEmpty())
     {
+        // Remember what this key started so it releases with the same notes,
+        // even if the layout is reloaded or transposed while it is held
+        audioProcessor.setSoundingNotesForKey(keyCode, midiNotes);
+        
         // Get velocity from MouseMidiExpression based on Y position
         int velocity = 100;  // Default fallback
         if (mouseMidiExpression != nullptr)
@@ -200,74 +233,47 @@ void StraDellaMIDIAudioProcessorEditor::handleKeyPress(int keyCode)
             velocity = mouseMidiExpression->getCurrentNoteVelocity();
         }
         
-        // CRITICAL PATH: Send ALL MIDI messages immediately with ZERO delays
+        STRADELLA_TRACE (debug, keyPressed, keyCode, midiNotes.size(), velocity);
+        
+        // CRITICAL PATH: Send ALL MIDI messages immediately with ZERO delays.
+        // The key highlight and the log follow on the next frame.
         for (int noteNumber : midiNotes)
         {
             auto message = juce::MidiMessage::noteOn(defaultMidiChannel, noteNumber, (juce::uint8)velocity);
-            sendMidiMessage(message);
+            sendMidiMessage(message, timestampTicks);
         }
         
-        // NON-CRITICAL: Update GUI asynchronously (won't block MIDI)
-        juce::MessageManager::callAsync([this, keyCode, midiNotes, velocity]()
-        {
-            if (keyboardGUI != nullptr)
-                keyboardGUI->setKeyPressed(keyCode, true);
-            
-            // Log messages asynchronously (now non-blocking with queue)
-            if (midiDisplay != nullptr)
-            {
-                for (int noteNumber : midiNotes)
-                {
-                    auto message = juce::MidiMessage::noteOn(defaultMidiChannel, noteNumber, (juce::uint8)velocity);
-                    midiDisplay->addMidiMessage(message);
-                }
-            }
-        });
+        recordKeyLatency(timestampTicks, lookupTicks);
     }
 }
 
-void StraDellaMIDIAudioProcessorEditor::handleKeyRelease(int keyCode)
+void StraDellaMIDIAudioProcessorEditor::handleKeyRelease(int keyCode, juce::int64 timestampTicks)
 {
-    bool isValidKey = false;
-    auto midiNotes = audioProcessor.getKeyboardMapper().getMidiNotesForKey(keyCode, isValidKey);
+    // Release the notes the key actually started, not what it maps to now
+    const auto midiNotes = audioProcessor.takeSoundingNotesForKey(keyCode);
+    const auto lookupTicks = juce::Time::getHighResolutionTicks();
     
-    if (isValidKey && !midiNotes.isEmpty())
+    if (!midiNotes.isEmpty())
     {
-        // CRITICAL PATH: Send ALL MIDI messages immediately with ZERO delays
+        STRADELLA_TRACE (debug, keyReleased, keyCode, midiNotes.size());
+        
+        // CRITICAL PATH: Send ALL MIDI messages immediately with ZERO delays.
+        // The key highlight and the log follow on the next frame.
         for (int noteNumber : midiNotes)
         {
             auto message = juce::MidiMessage::noteOff(defaultMidiChannel, noteNumber);
-            sendMidiMessage(message);
+            sendMidiMessage(message, timestampTicks);
         }
         
-        // NON-CRITICAL: Update GUI asynchronously (won't block MIDI)
-        juce::MessageManager::callAsync([this, keyCode, midiNotes]()
-        {
-            if (keyboardGUI != nullptr)
-                keyboardGUI->setKeyPressed(keyCode, false);
-            
-            // Log messages asynchronously (now non-blocking with queue)
-            if (midiDisplay != nullptr)
-            {
-                for (int noteNumber : midiNotes)
-                {
-                    auto message = juce::MidiMessage::noteOff(defaultMidiChannel, noteNumber);
-                    midiDisplay->addMidiMessage(message);
-                }
-            }
-        });
+        recordKeyLatency(timestampTicks, lookupTicks);
     }
 }
 
-void StraDellaMIDIAudioProcessorEditor::retriggerCurrentlyPressedKeys()
+void StraDellaMIDIAudioProcessorEditor::retriggerCurrentlyPressedKeys(juce::int64 timestampTicks)
 {
     // This simulates the bellows changing direction on an accordion
-    // All currently pressed keys briefly stop then resume
-    
-    auto& currentlyPressedKeys = audioProcessor.getCurrentlyPressedKeys();
-    
-    if (currentlyPressedKeys.isEmpty())
-        return;
+    // All currently pressed keys briefly stop then resume.
+    // Called on the expression sampling thread.
     
     // Get current velocity from mouse Y position
     int velocity = 100;  // Default fallback
@@ -276,50 +282,28 @@ void StraDellaMIDIAudioProcessorEditor::retriggerCurrentlyPressedKeys()
         velocity = mouseMidiExpression->getCurrentNoteVelocity();
     }
     
-    // For each currently pressed key, send note off then note on
-    for (int keyCode : currentlyPressedKeys)
-    {
-        bool isValidKey = false;
-        auto midiNotes = audioProcessor.getKeyboardMapper().getMidiNotesForKey(keyCode, isValidKey);
-        
-        if (isValidKey && !midiNotes.isEmpty())
-        {
-            // Send note off for all notes
-            for (int noteNumber : midiNotes)
-            {
-                auto offMessage = juce::MidiMessage::noteOff(defaultMidiChannel, noteNumber);
-                sendMidiMessage(offMessage);
-            }
-            
-            // Immediately send note on with current velocity
-            for (int noteNumber : midiNotes)
-            {
-                auto onMessage = juce::MidiMessage::noteOn(defaultMidiChannel, noteNumber, (juce::uint8)velocity);
-                sendMidiMessage(onMessage);
-            }
-            
-            // NON-CRITICAL: Update display asynchronously
-            juce::MessageManager::callAsync([this, midiNotes, velocity]()
-            {
-                if (midiDisplay != nullptr)
-                {
-                    for (int noteNumber : midiNotes)
-                    {
-                        auto offMessage = juce::MidiMessage::noteOff(defaultMidiChannel, noteNumber);
-                        auto onMessage = juce::MidiMessage::noteOn(defaultMidiChannel, noteNumber, (juce::uint8)velocity);
-                        midiDisplay->addMidiMessage(offMessage);
-                        midiDisplay->addMidiMessage(onMessage);
-                    }
-                }
-            });
-        }
-    }
+    // CRITICAL PATH: one wait-free request - the processor expands it from its own note
+    // state within a single block, with each shared note retriggered once
+    audioProcessor.reverseBellows(velocity, timestampTicks);
 }
 
-void StraDellaMIDIAudioProcessorEditor::sendMidiMessage(const juce::MidiMessage& message)
+void StraDellaMIDIAudioProcessorEditor::recordKeyLatency(juce::int64 keyEventTicks, juce::int64 lookupTicks)
+{
+    auto& latencyStats = audioProcessor.getLatencyStats();
+    latencyStats.recordTicks(LatencyStats::Stage::keyToLookup, lookupTicks - keyEventTicks);
+    latencyStats.recordTicks(LatencyStats::Stage::lookupToEnqueue, juce::Time::getHighResolutionTicks() - lookupTicks);
+}
+
+void StraDellaMIDIAudioProcessorEditor::setLatencyOverlayVisible(bool shouldBeVisible)
+{
+    latencyOverlay->setVisible(shouldBeVisible);
+    resized();
+}
+
+void StraDellaMIDIAudioProcessorEditor::sendMidiMessage(const juce::MidiMessage& message, juce::int64 timestampTicks)
 {
     // Send MIDI through the processor to the plugin host
-    audioProcessor.addMidiMessageToBuffer(message);
+    audioProcessor.addMidiMessageToBuffer(message, timestampTicks);
 }
 
 void StraDellaMIDIAudioProcessorEditor::toggleMouseSettings()
@@ -332,7 +316,7 @@ void StraDellaMIDIAudioProcessorEditor::toggleMouseSettings()
         if (!currentlyVisible)
         {
             // Center the window when showing
-            mouseSettingsWindow->centreWithSize(400, 350);
+            mouseSettingsWindow->centreWithSize(mouseSettingsWindow->getWidth(), mouseSettingsWindow->getHeight());
             mouseSettingsWindow->toFront(true);
         }
     }
@@ -340,14 +324,117 @@ void StraDellaMIDIAudioProcessorEditor::toggleMouseSettings()
 
 void StraDellaMIDIAudioProcessorEditor::showNoteMapSettings()
 {
-    // Placeholder for future Note Map Settings dialog
-    // This will be implemented in a future iteration
-    juce::Logger::writeToLog("Note Map Settings button clicked - feature coming soon");
+    auto& mapper = audioProcessor.getKeyboardMapper();
+    const int currentTranspose = mapper.getTranspose();
+    
+    // Transposition is a pointer swap in the mapper, so it is safe while notes are held
+    juce::PopupMenu transposeMenu;
+    
+    for (int semitones = StradellaKeyboardMapper::maxTransposeSemitones;
+         semitones >= -StradellaKeyboardMapper::maxTransposeSemitones; --semitones)
+    {
+        juce::String name = semitones > 0 ? "+" + juce::String(semitones) : juce::String(semitones);
+        
+        if (std::abs(semitones) == 12)
+            name += semitones > 0 ? " (octave up)" : " (octave down)";
+        
+        transposeMenu.addItem(transposeMenuIdOffset + semitones, name, true, semitones == currentTranspose);
+    }
+    
+    juce::PopupMenu menu;
+    menu.addSectionHeader("Keyboard Mapping");
+    menu.addSubMenu("Transpose", transposeMenu);
+    menu.addItem(reloadMappingMenuId, "Reload Mapping File");
+    
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&noteMapSettingsButton),
+                       [&mapper](int result)
+                       {
+                           if (result == reloadMappingMenuId)
+                           {
+                               if (!mapper.loadConfiguration(StradellaKeyboardMapper::getUserConfigurationFile()))
+                                   mapper.loadDefaultConfiguration();
+                           }
+                           else if (result != 0)
+                           {
+                               mapper.setTranspose(result - transposeMenuIdOffset);
+                           }
+                       });
 }
 
 void StraDellaMIDIAudioProcessorEditor::showMidiSettings()
 {
-    // Placeholder for future MIDI Settings dialog
-    // This will be implemented in a future iteration
-    juce::Logger::writeToLog("MIDI Settings button clicked - feature coming soon");
+    const bool fixedLatency = audioProcessor.isFixedLatencyModeEnabled();
+    const bool retriggerRepeated = audioProcessor.getRetriggerPolicy()
+                                       == NoteStateTracker::RetriggerPolicy::RetriggerRepeatedNoteOn;
+    
+    juce::PopupMenu menu;
+    menu.addSectionHeader("Event Timing");
+    menu.addItem(1, "Sample-accurate (lowest latency)", true, !fixedLatency);
+    menu.addItem(2, "Fixed latency (one block, reported to host)", true, fixedLatency);
+    menu.addSectionHeader("Shared Notes");
+    menu.addItem(3, "Hold sounding notes (no retrigger)", true, !retriggerRepeated);
+    menu.addItem(4, "Retrigger when another key plays the note", true, retriggerRepeated);
+    
+    // Menu IDs 11, 12, 14, 18 = that many values per controller per block
+    const int maxControllerValues = audioProcessor.getMaxControllerValuesPerBlock();
+    juce::PopupMenu controllerMenu;
+    
+    for (int maxValues : { 1, 2, 4, 8 })
+        controllerMenu.addItem(controllerResolutionMenuIdOffset + maxValues,
+                               maxValues == 1 ? juce::String("Latest value only") : juce::String(maxValues) + " steps",
+                               true, maxValues == maxControllerValues);
+    
+    menu.addSubMenu("CC1/CC11 Values Per Block", controllerMenu);
+    
+    menu.addSectionHeader("Latency");
+    menu.addItem(showLatencyMenuId, "Show latency overlay", true, latencyOverlay->isVisible());
+    menu.addItem(saveLatencyReportMenuId, "Save latency report");
+    menu.addItem(resetLatencyMenuId, "Reset latency statistics");
+    
+   #if STRADELLA_ENABLE_TRACING
+    // Menu IDs traceLevelMenuIdOffset + level
+    const auto traceLevel = TraceLogger::getInstance()->getLevel();
+    juce::PopupMenu traceMenu;
+    
+    for (auto level : { TraceLogger::Level::off, TraceLogger::Level::error, TraceLogger::Level::info,
+                        TraceLogger::Level::debug, TraceLogger::Level::verbose })
+        traceMenu.addItem(traceLevelMenuIdOffset + (int)level, TraceLogger::getLevelName(level), true, level == traceLevel);
+    
+    menu.addSubMenu("Trace Level", traceMenu);
+   #endif
+    
+    // Capture the processor (it outlives any open menu) and only a safe pointer to the editor
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&midiSettingsButton),
+                       [&processor = audioProcessor,
+                        safeThis = juce::Component::SafePointer<StraDellaMIDIAudioProcessorEditor>(this)](int result)
+                       {
+                           if (result == showLatencyMenuId)
+                           {
+                               if (safeThis != nullptr)
+                                   safeThis->setLatencyOverlayVisible(!safeThis->latencyOverlay->isVisible());
+                           }
+                           else if (result == saveLatencyReportMenuId)
+                           {
+                               const auto reportFile = processor.getLatencyStats().writeReportFile();
+                               
+                               if (reportFile.existsAsFile())
+                                   reportFile.revealToUser();
+                           }
+                           else if (result == resetLatencyMenuId)
+                               processor.getLatencyStats().reset();
+                           else if (result == 1)
+                               processor.setFixedLatencyMode(false);
+                           else if (result == 2)
+                               processor.setFixedLatencyMode(true);
+                           else if (result == 3)
+                               processor.setRetriggerPolicy(NoteStateTracker::RetriggerPolicy::IgnoreRepeatedNoteOn);
+                           else if (result == 4)
+                               processor.setRetriggerPolicy(NoteStateTracker::RetriggerPolicy::RetriggerRepeatedNoteOn);
+                          #if STRADELLA_ENABLE_TRACING
+                           else if (result >= traceLevelMenuIdOffset)
+                               TraceLogger::getInstance()->setLevel((TraceLogger::Level)(result - traceLevelMenuIdOffset));
+                          #endif
+                           else if (result > controllerResolutionMenuIdOffset)
+                               processor.setMaxControllerValuesPerBlock(result - controllerResolutionMenuIdOffset);
+                       });
 }
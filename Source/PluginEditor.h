@@ -12,6 +12,8 @@
 #include "PluginProcessor.h"
 #include "KeyboardGUI.h"
 #include "MIDIMessageDisplay.h"
+#include "GuiFrameScheduler.h"
+#include "LatencyOverlay.h"
 #include "MouseMidiExpression.h"
 #include "MouseMidiSettingsWindow.h"
 
@@ -45,6 +47,12 @@ private:
     std::unique_ptr<KeyboardGUI> keyboardGUI;
     std::unique_ptr<MIDIMessageDisplay> midiDisplay;
     
+    // Applies key highlights and log entries once per display frame
+    std::unique_ptr<GuiFrameScheduler> frameScheduler;
+    
+    // Optional latency histograms next to the MIDI log
+    std::unique_ptr<LatencyOverlay> latencyOverlay;
+    
     // Mouse MIDI expression components
     std::unique_ptr<MouseMidiExpression> mouseMidiExpression;
     std::unique_ptr<MouseMidiSettingsWindow> mouseSettingsWindow;
@@ -57,13 +65,27 @@ private:
     // MIDI channel for output
     static constexpr int defaultMidiChannel = 1;
     
-    void sendMidiMessage(const juce::MidiMessage& message);
-    void handleKeyPress(int keyCode);
-    void handleKeyRelease(int keyCode);
-    void retriggerCurrentlyPressedKeys();
+    // Note Map Settings menu item IDs (transpose items are offset so they stay positive)
+    static constexpr int reloadMappingMenuId = 1;
+    static constexpr int transposeMenuIdOffset = 100;
+    
+    // MIDI Settings menu: controller resolution items are offset past the fixed items
+    static constexpr int controllerResolutionMenuIdOffset = 10;
+    static constexpr int traceLevelMenuIdOffset = 30;
+    static constexpr int showLatencyMenuId = 5;
+    static constexpr int saveLatencyReportMenuId = 6;
+    static constexpr int resetLatencyMenuId = 7;
+    
+    void sendMidiMessage(const juce::MidiMessage& message, juce::int64 timestampTicks);
+    void handleKeyPress(int keyCode, juce::int64 timestampTicks);
+    void handleKeyRelease(int keyCode, juce::int64 timestampTicks);
+    void retriggerCurrentlyPressedKeys(juce::int64 timestampTicks);
+    /** Records the key handling stages: key event to lookup, lookup to everything queued */
+    void recordKeyLatency(juce::int64 keyEventTicks, juce::int64 lookupTicks);
     void toggleMouseSettings();
     void showNoteMapSettings();
     void showMidiSettings();
+    void setLatencyOverlayVisible(bool shouldBeVisible);
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StraDellaMIDIAudioProcessorEditor)
 };
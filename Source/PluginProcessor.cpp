@@ -10,7 +10,7 @@
 #include "PluginEditor.h"
 
 //==============================================================================
-StraDellaMIDIAudioProcessor::StraDellaMIDIAudioProcessor()
+StraDellaMIDIAudioProcessor::StraDellaMIDIAudioProcessor(bool useUserMappingFile)
 #ifndef JucePlugin_PreferredChannelConfigurations
      : AudioProcessor (BusesProperties()
                      #if ! JucePlugin_IsMidiEffect
@@ -22,6 +22,20 @@ StraDellaMIDIAudioProcessor::StraDellaMIDIAudioProcessor()
                        )
 #endif
 {
+    if (useUserMappingFile)
+    {
+        // Use the user's mapping file if there is one - the cached compiled image makes this cheap
+        const auto userMappingFile = StradellaKeyboardMapper::getUserConfigurationFile();
+        keyboardMapper.loadConfiguration(userMappingFile);
+        
+        // Pick up edits (or a newly created file) without reloading the plugin
+        keyboardMapper.watchConfigurationFile(userMappingFile);
+    }
+    
+   #if STRADELLA_ENABLE_TRACING
+    // Create the trace logger here - trace calls on the real-time threads never create it
+    TraceLogger::getInstance();
+   #endif
 }
 
 StraDellaMIDIAudioProcessor::~StraDellaMIDIAudioProcessor()
@@ -93,8 +107,40 @@ void StraDellaMIDIAudioProcessor::changeProgramName (int index, const juce::Stri
 //==============================================================================
 void StraDellaMIDIAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    currentSampleRate = sampleRate;
+    currentBlockSize = samplesPerBlock;
+    
+    // No block has started yet - the first block places everything at offset 0
+    previousBlockStartTicks = 0;
+    blockIndex = 0;
+    
+    jitterBuffer.prepare(sampleRate);
+    controllerEnvelopes.prepare(sampleRate);
+    
+    // The note state survives a re-prepare: whatever is sounding downstream is still owned by
+    // its keys, so their note-offs go out when they're released instead of being dropped
+    
+    // Staging room for anything the pipeline can produce in one block with any layout: a full
+    // input queue of retriggers (off + on each) and a reversal re-articulating every possible note
+    const int maxStagedEvents = 2 * MidiEventFifo::capacity
+                              + 2 * NoteStateTracker::numChannels * NoteStateTracker::numNotes
+                              + ControllerEnvelopeGenerator::numControllers * ControllerEnvelopeGenerator::maxValuesPerBlockLimit;
+    
+    // The budget itself follows the current layout; processBlock updates it when the layout changes
+    outputBudget.prepare(maxStagedEvents);
+    outputBudget.setMaxEventsPerBlock(getEventBudget(keyboardMapper.getLayoutSize()));
+    updateLatency();
+}
+
+int StraDellaMIDIAudioProcessor::getEventBudget(const StradellaKeyboardMapper::LayoutSize& layoutSize) noexcept
+{
+    const int numKeyNotes = layoutSize.numKeyNotes;
+    const int polyphony = layoutSize.polyphony;
+    
+    // Each key note: a note-on or a retrigger (off + on), then a note-off.
+    // The reversal re-articulates every sounding note (off + on).
+    return 3 * numKeyNotes + 2 * polyphony
+         + ControllerEnvelopeGenerator::numControllers * ControllerEnvelopeGenerator::maxValuesPerBlockLimit;
 }
 
 void StraDellaMIDIAudioProcessor::releaseResources()
@@ -137,12 +183,162 @@ void StraDellaMIDIAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // Add pending MIDI messages from the editor to the output
+    const int numSamples = buffer.getNumSamples();
+    const auto blockStartTicks = juce::Time::getHighResolutionTicks();
+    
+    const int latencySamples = activeLatencySamples.load(std::memory_order_relaxed);
+    
+    using Counter = PerformanceCounters::Counter;
+    performanceCounters.updateMax(Counter::queueHighWaterMark,
+                                  (juce::uint64)juce::jmax(pendingMidiMessages.getNumPendingEvents(),
+                                                           pendingBellowsReversals.getNumPendingEvents()));
+    
+    // Every editor event goes through the note state tracker, so overlapping keys
+    // that share a note never cut each other off
+    auto& stagedMessages = outputBudget.getStagingBuffer();
+    
+    // The mapper may have published a layout of a different size since the last block
+    outputBudget.setMaxEventsPerBlock(getEventBudget(keyboardMapper.getLayoutSize()));
+    
+    auto emit = [this, &stagedMessages, blockStartTicks](const MidiEventFifo::Event& event, int sampleOffset)
+    {
+        noteState.processEvent(event, sampleOffset, stagedMessages);
+        
+        if (event.size > 0)
+            recordEventLatency(event, blockStartTicks, sampleOffset);
+    };
+    
+    // Keep using the jitter buffer until it has emptied after leaving fixed-latency mode
+    const bool useJitterBuffer = latencySamples > 0 || jitterBuffer.hasDelayedEvents();
+    
+    // Add pending MIDI messages from the editor to the output (wait-free, no allocation).
+    // Key events and bellows reversals are merged in capture order, so the note state
+    // tracker sees a reversal exactly between the keys pressed before and after it.
+    if (useJitterBuffer)
     {
-        juce::ScopedLock lock(midiBufferLock);
-        midiMessages.addEvents(pendingMidiMessages, 0, buffer.getNumSamples(), 0);
-        pendingMidiMessages.clear();
+        // Fixed-latency mode: every event lands exactly latencySamples after it was captured.
+        // If the buffer is full, note-ons and reversals are dropped but note-offs never are.
+        const int numDropped = jitterBuffer.process(pendingMidiMessages, pendingBellowsReversals, blockStartTicks,
+                                                    numSamples, latencySamples, emit);
+        
+        if (numDropped > 0)
+            performanceCounters.add(Counter::eventsDropped, (juce::uint64)numDropped);
     }
+    else if (pendingMidiMessages.hasPendingEvents() || pendingBellowsReversals.hasPendingEvents())
+    {
+        // Events captured since the previous block started keep their relative timing,
+        // which delays them by one block but removes the block-boundary jitter.
+        pendingMidiMessages.drainMerged(pendingBellowsReversals, [this, &emit, numSamples](const MidiEventFifo::Event& event)
+        {
+            emit(event, getSampleOffsetForTimestamp(event.timestampTicks, numSamples));
+        });
+    }
+    
+    // Controller glides and decay, at most the configured number of values each. Targets get
+    // the same delay as the notes, so they stay aligned after the host's latency compensation.
+    const auto numSupersededTargets = controllerEnvelopes.process(stagedMessages, numSamples,
+                                                                  [this, numSamples, blockStartTicks, latencySamples](juce::int64 timestampTicks)
+    {
+        return latencySamples > 0 ? getDelayedSampleOffset(timestampTicks, blockStartTicks, latencySamples)
+                                  : getSampleOffsetForTimestamp(timestampTicks, numSamples);
+    });
+    
+    if (numSupersededTargets > 0)
+        performanceCounters.add(Counter::eventsCoalesced, numSupersededTargets);
+    
+    // A host buffer smaller than the budget has to grow here, which allocates on the audio
+    // thread. Hosts reuse their buffers, so it's rare - count it rather than hide it.
+    const auto* hostBufferData = midiMessages.data.data();
+    midiMessages.ensureSize(outputBudget.getMaxBytesPerBlock());
+    
+    if (midiMessages.data.data() != hostBufferData)
+        performanceCounters.add(Counter::outputBufferGrown);
+    
+    // Over budget, stale CCs go first, then note-ons that end within the block; never note-offs
+    const auto decisions = outputBudget.write(midiMessages);
+    
+    if (decisions.numControllersCoalesced > 0)
+        performanceCounters.add(Counter::outputControllersCoalesced, (juce::uint64)decisions.numControllersCoalesced);
+    
+    if (decisions.numNoteOnsDropped > 0)
+        performanceCounters.add(Counter::outputNoteOnsDropped, (juce::uint64)decisions.numNoteOnsDropped);
+    
+    if (decisions.budgetExceeded)
+        performanceCounters.add(Counter::outputBudgetExceeded);
+    
+    const auto numEmittedEvents = (juce::uint64)midiMessages.getNumEvents();
+    performanceCounters.add(Counter::blocksProcessed);
+    
+    if (numEmittedEvents > 0)
+    {
+        performanceCounters.add(Counter::blocksWithEvents);
+        performanceCounters.updateMax(Counter::maxEventsPerBlock, numEmittedEvents);
+    }
+    
+    // Show the editor exactly what the host receives
+    if (outputMonitoringEnabled.load(std::memory_order_relaxed))
+        publishEmittedEvents(midiMessages, blockStartTicks);
+    
+    ++blockIndex;
+    previousBlockStartTicks = blockStartTicks;
+}
+
+void StraDellaMIDIAudioProcessor::recordEventLatency(const MidiEventFifo::Event& event, juce::int64 blockStartTicks,
+                                                     int sampleOffset) noexcept
+{
+    using Stage = LatencyStats::Stage;
+    
+    const auto offsetMicroseconds = (juce::int64)((double)sampleOffset * 1.0e6 / currentSampleRate);
+    const auto keyToBlockMicroseconds = (juce::int64)(juce::Time::highResolutionTicksToSeconds(blockStartTicks - event.timestampTicks) * 1.0e6);
+    
+    latencyStats.recordTicks(Stage::queueWait, blockStartTicks - event.enqueueTicks);
+    latencyStats.recordMicroseconds(Stage::blockOffset, offsetMicroseconds);
+    latencyStats.recordMicroseconds(Stage::keyToOutput, keyToBlockMicroseconds + offsetMicroseconds);
+}
+
+void StraDellaMIDIAudioProcessor::publishEmittedEvents(const juce::MidiBuffer& midiMessages, juce::int64 blockStartTicks) noexcept
+{
+    for (const auto metadata : midiMessages)
+    {
+        if (metadata.numBytes <= 0 || metadata.numBytes > 3)
+            continue; // SysEx isn't generated here
+        
+        MidiCaptureQueue::Event event {};
+        event.timestampTicks = blockStartTicks;
+        event.blockIndex = blockIndex;
+        event.sampleOffset = metadata.samplePosition;
+        event.size = (juce::uint8)metadata.numBytes;
+        std::copy(metadata.data, metadata.data + metadata.numBytes, event.data);
+        
+        // A full queue is counted and shown in the log panel
+        emittedEvents.push(event);
+    }
+}
+
+int StraDellaMIDIAudioProcessor::getSampleOffsetForTimestamp(juce::int64 timestampTicks, int numSamples) const noexcept
+{
+    if (numSamples <= 0)
+        return 0;
+    
+    if (previousBlockStartTicks == 0 || timestampTicks <= previousBlockStartTicks)
+        return 0;
+    
+    const double secondsIntoBlock = juce::Time::highResolutionTicksToSeconds(timestampTicks - previousBlockStartTicks);
+    const auto sampleOffset = (juce::int64)(secondsIntoBlock * currentSampleRate);
+    
+    // Events that arrived late (e.g. after a host stall) land on the last sample
+    return (int)juce::jmin(sampleOffset, (juce::int64)(numSamples - 1));
+}
+
+int StraDellaMIDIAudioProcessor::getDelayedSampleOffset(juce::int64 timestampTicks, juce::int64 blockStartTicks,
+                                                        int latencySamples) const noexcept
+{
+    // Same placement as MidiJitterBuffer: latencySamples after capture, measured from this block
+    const double secondsAgo = juce::Time::highResolutionTicksToSeconds(blockStartTicks - timestampTicks);
+    const auto samplesAgo = (juce::int64)(secondsAgo * currentSampleRate);
+    
+    // Targets that are already late go at the start
+    return (int)juce::jlimit((juce::int64)0, (juce::int64)latencySamples, (juce::int64)latencySamples - samplesAgo);
 }
 
 //==============================================================================
@@ -171,10 +367,71 @@ void StraDellaMIDIAudioProcessor::setStateInformation (const void* data, int siz
 }
 
 //==============================================================================
-void StraDellaMIDIAudioProcessor::addMidiMessageToBuffer(const juce::MidiMessage& message)
+void StraDellaMIDIAudioProcessor::addMidiMessageToBuffer(const juce::MidiMessage& message, juce::int64 timestampTicks)
+{
+    // Single producer: all editor-originated messages are sent from the message thread
+    if (pendingMidiMessages.push(message, timestampTicks))
+    {
+        performanceCounters.add(PerformanceCounters::Counter::eventsEnqueued);
+    }
+    else
+    {
+        performanceCounters.add(PerformanceCounters::Counter::eventsDropped);
+        STRADELLA_TRACE (error, midiQueueFull, message.getRawData()[0], message.getRawDataSize() > 1 ? message.getRawData()[1] : 0);
+    }
+}
+
+void StraDellaMIDIAudioProcessor::setSoundingNotesForKey(int keyCode, const StradellaKeyboardMapper::NoteList& notes) noexcept
+{
+    if (juce::isPositiveAndBelow(keyCode, StradellaKeyboardMapper::numKeyCodes))
+        soundingNotesForKey[(size_t)keyCode] = notes;
+}
+
+StradellaKeyboardMapper::NoteList StraDellaMIDIAudioProcessor::takeSoundingNotesForKey(int keyCode) noexcept
+{
+    if (!juce::isPositiveAndBelow(keyCode, StradellaKeyboardMapper::numKeyCodes))
+        return {};
+    
+    const auto notes = soundingNotesForKey[(size_t)keyCode];
+    soundingNotesForKey[(size_t)keyCode] = {};
+    return notes;
+}
+
+void StraDellaMIDIAudioProcessor::reverseBellows(int velocity, juce::int64 timestampTicks)
+{
+    const auto noteVelocity = (juce::uint8)juce::jlimit(1, 127, velocity);
+    
+    if (pendingBellowsReversals.pushCommand(MidiEventFifo::bellowsReversalFlag, noteVelocity, timestampTicks))
+    {
+        performanceCounters.add(PerformanceCounters::Counter::eventsEnqueued);
+        STRADELLA_TRACE (debug, bellowsReversal, velocity);
+    }
+    else
+    {
+        performanceCounters.add(PerformanceCounters::Counter::eventsDropped);
+        STRADELLA_TRACE (error, midiQueueFull, 0, 0);
+    }
+}
+
+void StraDellaMIDIAudioProcessor::setFixedLatencyMode(bool shouldBeEnabled, int latencySamples)
+{
+    fixedLatencyEnabled = shouldBeEnabled;
+    requestedLatencySamples = latencySamples;
+    updateLatency();
+}
+
+void StraDellaMIDIAudioProcessor::updateLatency()
 {
-    juce::ScopedLock lock(midiBufferLock);
-    pendingMidiMessages.addEvent(message, 0);
+    int latency = 0;
+    
+    if (fixedLatencyEnabled)
+        latency = requestedLatencySamples > 0 ? requestedLatencySamples : currentBlockSize;
+    
+    activeLatencySamples.store(latency, std::memory_order_relaxed);
+    
+    // Let the host compensate for the constant delay
+    if (getLatencySamples() != latency)
+        setLatencySamples(latency);
 }
 
 //==============================================================================
@@ -10,6 +10,16 @@
 
 #include <JuceHeader.h>
 #include "StradellaKeyboardMapper.h"
+#include "MidiEventFifo.h"
+#include "MidiJitterBuffer.h"
+#include "NoteStateTracker.h"
+#include "ControllerEnvelopeGenerator.h"
+#include "MidiOutputBudget.h"
+#include "TraceLogger.h"
+#include "KeyStateSet.h"
+#include "MidiCaptureQueue.h"
+#include "LatencyStats.h"
+#include "PerformanceCounters.h"
 
 //==============================================================================
 /**
@@ -18,7 +28,9 @@ class StraDellaMIDIAudioProcessor  : public juce::AudioProcessor
 {
 public:
     //==============================================================================
-    StraDellaMIDIAudioProcessor();
+    /** With useUserMappingFile false the processor keeps the built-in layout and never reads
+        the user's mapping file, so tools like the benchmark behave the same on every machine. */
+    explicit StraDellaMIDIAudioProcessor(bool useUserMappingFile = true);
     ~StraDellaMIDIAudioProcessor() override;
 
     //==============================================================================
@@ -58,20 +70,123 @@ public:
     // Public methods for editor to access
     StradellaKeyboardMapper& getKeyboardMapper() { return keyboardMapper; }
     
-    // MIDI output handling - called by editor
-    void addMidiMessageToBuffer(const juce::MidiMessage& message);
+    // MIDI output handling - called by editor (message thread only, never blocks)
+    // timestampTicks is the capture time from juce::Time::getHighResolutionTicks()
+    void addMidiMessageToBuffer(const juce::MidiMessage& message, juce::int64 timestampTicks);
     
-    // Track currently pressed keys for editor
-    juce::Array<int>& getCurrentlyPressedKeys() { return currentlyPressedKeys; }
+    // Continuous controllers (CC1/CC11) are generated in processBlock from the latest target.
+    // Returns false for controllers that aren't generated - send those with addMidiMessageToBuffer.
+    bool setControllerTarget(int controllerNumber, int value, juce::int64 timestampTicks)
+    {
+        return controllerEnvelopes.setTarget(controllerNumber, value, timestampTicks);
+    }
+    
+    // How long controllers hold after the last target, and how long they take to decay to 0 (any thread)
+    void setControllerDecay(double delaySeconds, double durationSeconds) { controllerEnvelopes.setDecay(delaySeconds, durationSeconds); }
+    
+    // Sub-block resolution: upper bound on values sent per controller per block (any thread)
+    void setMaxControllerValuesPerBlock(int maxValues) { controllerEnvelopes.setMaxValuesPerBlock(maxValues); }
+    int getMaxControllerValuesPerBlock() const { return controllerEnvelopes.getMaxValuesPerBlock(); }
+    
+    // Bellows reversal: a single command that re-articulates every sounding note at once,
+    // from the processor's own note state. Single producer (the expression sampling
+    // thread), wait-free; merged with the editor's events in capture order.
+    void reverseBellows(int velocity, juce::int64 timestampTicks);
+    
+    // Fixed-latency mode: delays every editor event by a constant amount and reports it
+    // to the host. latencySamples <= 0 means "one block". Message thread only.
+    void setFixedLatencyMode(bool shouldBeEnabled, int latencySamples = 0);
+    bool isFixedLatencyModeEnabled() const { return fixedLatencyEnabled; }
+    
+    // How a note-on for a note another key is already holding is handled (any thread)
+    void setRetriggerPolicy(NoteStateTracker::RetriggerPolicy policy) { noteState.setRetriggerPolicy(policy); }
+    NoteStateTracker::RetriggerPolicy getRetriggerPolicy() const { return noteState.getRetriggerPolicy(); }
+    
+    // Held computer keys - updated by the editor, readable from any thread
+    KeyStateSet& getKeyState() { return keyState; }
+    
+    // Notes started by each held key, so a release uses the mapping that was active at
+    // press time. Kept here with the key state so held keys survive the editor closing.
+    // Message thread only.
+    void setSoundingNotesForKey(int keyCode, const StradellaKeyboardMapper::NoteList& notes) noexcept;
+    
+    // Returns the notes the key started and forgets them (message thread only)
+    StradellaKeyboardMapper::NoteList takeSoundingNotesForKey(int keyCode) noexcept;
+    
+    // Every event processBlock writes to the host buffer, while monitoring is enabled.
+    // The editor is the only consumer.
+    MidiCaptureQueue& getEmittedEvents() { return emittedEvents; }
+    void setOutputMonitoringEnabled(bool shouldBeEnabled) { outputMonitoringEnabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+    
+    // Per-stage key-to-host latency. The editor records the key handling stages,
+    // processBlock the queue and block stages. Readable from any thread.
+    LatencyStats& getLatencyStats() { return latencyStats; }
+    
+    // Counters published in this instance's memory-mapped stats file
+    PerformanceCounters& getPerformanceCounters() { return performanceCounters; }
+    
+    // Events per block the output budget currently allows (follows the layout)
+    int getOutputEventBudget() const { return outputBudget.getMaxEventsPerBlock(); }
 
 private:
     //==============================================================================
     StradellaKeyboardMapper keyboardMapper;
-    juce::Array<int> currentlyPressedKeys;
+    KeyStateSet keyState;
+    std::array<StradellaKeyboardMapper::NoteList, StradellaKeyboardMapper::numKeyCodes> soundingNotesForKey {};
+    
+    // Lock-free queue of MIDI messages from the editor, drained in processBlock
+    MidiEventFifo pendingMidiMessages;
+    
+    // Block timing used to place editor events at their sample position
+    double currentSampleRate = 44100.0;
+    int currentBlockSize = 512;
+    juce::int64 previousBlockStartTicks = 0;
+    
+    // Fixed-latency (jitter buffer) mode
+    MidiJitterBuffer jitterBuffer;
+    bool fixedLatencyEnabled = false;
+    int requestedLatencySamples = 0;
+    std::atomic<int> activeLatencySamples { 0 };    // 0 = sample-accurate mode
+    
+    void updateLatency();
+    
+    // Reference-counted note ownership, applied to everything the editor sends
+    NoteStateTracker noteState;
+    
+    // Expression controller ramps and decay, rendered on the audio clock
+    ControllerEnvelopeGenerator controllerEnvelopes;
+    
+    // Events are generated into the budget's preallocated staging buffer, then copied
+    // to the host under the overflow policy
+    MidiOutputBudget outputBudget;
+    
+    /** Output events for the worst realistic block with a given layout: every mapped key's notes
+        pressed (or retriggered) and released, a bellows reversal and full controller ramps */
+    static int getEventBudget(const StradellaKeyboardMapper::LayoutSize& layoutSize) noexcept;
+    
+    // Output monitor for the MIDI log
+    MidiCaptureQueue emittedEvents;
+    std::atomic<bool> outputMonitoringEnabled { false };
+    juce::int64 blockIndex = 0;                     // Audio thread only
+    
+    void publishEmittedEvents(const juce::MidiBuffer& midiMessages, juce::int64 blockStartTicks) noexcept;
+    
+    LatencyStats latencyStats;
+    PerformanceCounters performanceCounters;
+    
+    /** Records the queue and block stages for an editor event emitted at sampleOffset */
+    void recordEventLatency(const MidiEventFifo::Event& event, juce::int64 blockStartTicks, int sampleOffset) noexcept;
+    
+    // Bellows reversal commands from the expression sampling thread. A queue of its own
+    // keeps each FIFO single-producer; processBlock merges the two by capture time.
+    MidiEventFifo pendingBellowsReversals;
+    
+    /** Maps an event capture time to a sample offset inside the block that started at previousBlockStartTicks */
+    int getSampleOffsetForTimestamp(juce::int64 timestampTicks, int numSamples) const noexcept;
     
-    // MIDI buffer for messages from the editor
-    juce::MidiBuffer pendingMidiMessages;
-    juce::CriticalSection midiBufferLock;
+    /** Fixed-latency mode: the offset from this block's start at which an event captured at
+        timestampTicks is due, latencySamples after capture (may lie beyond this block) */
+    int getDelayedSampleOffset(juce::int64 timestampTicks, juce::int64 blockStartTicks, int latencySamples) const noexcept;
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StraDellaMIDIAudioProcessor)
 };
@@ -0,0 +1,179 @@
+#include "ResponseCurve.h"
+
+//==============================================================================
+namespace ResponseCurve
+{
+    namespace
+    {
+        /** Fills both tables of a curve from a function of x (0-1) */
+        template <typename Function>
+        Table evaluateIntoTable(Function&& function)
+        {
+            Table table;
+            
+            for (int i = 0; i < normalisedTableSize; ++i)
+                table.normalised[(size_t)i] = juce::jlimit(0.0f, 1.0f, function((float)i / (float)(normalisedTableSize - 1)));
+            
+            for (int i = 0; i < midiTableSize; ++i)
+            {
+                const float y = table.applyNormalised((float)i / (float)(midiTableSize - 1));
+                table.midi[(size_t)i] = (juce::uint8)juce::roundToInt(y * (float)(midiTableSize - 1));
+            }
+            
+            return table;
+        }
+    }
+    
+    Table makePiecewiseTable(const juce::Array<juce::Point<float>>& points)
+    {
+        if (points.size() < 2)
+            return builtInTable<Shape::Linear>;
+        
+        return evaluateIntoTable([&points](float x)
+        {
+            if (x <= points.getFirst().x)
+                return points.getFirst().y;
+            
+            for (int i = 1; i < points.size(); ++i)
+            {
+                const auto start = points[i - 1];
+                const auto end = points[i];
+                
+                if (x <= end.x)
+                {
+                    const float width = end.x - start.x;
+                    return width > 0.0f ? start.y + (end.y - start.y) * (x - start.x) / width : end.y;
+                }
+            }
+            
+            return points.getLast().y;
+        });
+    }
+    
+    Table makeBezierTable(juce::Point<float> control1, juce::Point<float> control2)
+    {
+        // Sample the curve parametrically, then resample it on a uniform x grid
+        constexpr int numSegments = normalisedTableSize * 2;
+        std::vector<juce::Point<float>> samples;
+        samples.reserve((size_t)numSegments + 1);
+        
+        for (int i = 0; i <= numSegments; ++i)
+        {
+            const float t = (float)i / (float)numSegments;
+            const float u = 1.0f - t;
+            const float a = 3.0f * u * u * t;
+            const float b = 3.0f * u * t * t;
+            const float c = t * t * t;
+            
+            samples.push_back({ a * control1.x + b * control2.x + c,
+                                a * control1.y + b * control2.y + c });
+        }
+        
+        size_t segment = 1;
+        
+        return evaluateIntoTable([&samples, &segment](float x)
+        {
+            // x only ever increases, so the search continues where it left off
+            while (segment < samples.size() - 1 && samples[segment].x < x)
+                ++segment;
+            
+            const auto start = samples[segment - 1];
+            const auto end = samples[segment];
+            const float width = end.x - start.x;
+            
+            return width > 0.0f ? start.y + (end.y - start.y) * (x - start.x) / width : end.y;
+        });
+    }
+    
+    juce::String getShapeName(Shape shape)
+    {
+        switch (shape)
+        {
+            case Shape::Linear:         return "Linear";
+            case Shape::Exponential:    return "Exponential";
+            case Shape::Logarithmic:    return "Logarithmic";
+            case Shape::SCurve:         return "S-Curve";
+            case Shape::Custom:         return "Custom";
+            default:                    return {};
+        }
+    }
+}
+
+//==============================================================================
+ResponseCurveSet::ResponseCurveSet()
+{
+    for (size_t i = 0; i < (size_t)numTargets; ++i)
+    {
+        tables[i].store(&ResponseCurve::builtInTable<ResponseCurve::Shape::Linear>);
+        shapes[i] = ResponseCurve::Shape::Linear;
+        customPoints[i] = { { 0.0f, 0.0f }, { 0.25f, 0.25f }, { 0.5f, 0.5f }, { 0.75f, 0.75f }, { 1.0f, 1.0f } };
+    }
+}
+
+ResponseCurveSet::~ResponseCurveSet()
+{
+}
+
+void ResponseCurveSet::setShape(Target target, ResponseCurve::Shape shape)
+{
+    using ResponseCurve::Shape;
+    
+    shapes[(size_t)target] = shape;
+    
+    switch (shape)
+    {
+        case Shape::Linear:         publish(target, &ResponseCurve::builtInTable<Shape::Linear>, nullptr); break;
+        case Shape::Exponential:    publish(target, &ResponseCurve::builtInTable<Shape::Exponential>, nullptr); break;
+        case Shape::Logarithmic:    publish(target, &ResponseCurve::builtInTable<Shape::Logarithmic>, nullptr); break;
+        
+        case Shape::SCurve:
+        {
+            auto table = std::make_unique<ResponseCurve::Table>(ResponseCurve::makeBezierTable({ 0.6f, 0.0f }, { 0.4f, 1.0f }));
+            publish(target, table.get(), std::move(table));
+            break;
+        }
+        
+        case Shape::Custom:
+        {
+            auto table = std::make_unique<ResponseCurve::Table>(ResponseCurve::makePiecewiseTable(customPoints[(size_t)target]));
+            publish(target, table.get(), std::move(table));
+            break;
+        }
+        
+        default:
+            jassertfalse;
+            break;
+    }
+}
+
+void ResponseCurveSet::setCustomPoints(Target target, const juce::Array<juce::Point<float>>& points)
+{
+    customPoints[(size_t)target] = points;
+    setShape(target, ResponseCurve::Shape::Custom);
+}
+
+void ResponseCurveSet::publish(Target target, const ResponseCurve::Table* table,
+                               std::unique_ptr<ResponseCurve::Table> ownedTable)
+{
+    reclaimRetiredTables();
+    
+    tables[(size_t)target].store(table, std::memory_order_release);
+    
+    // A reader may still be using the previous user table - keep it alive for a while
+    if (userTables[(size_t)target] != nullptr)
+        retiredTables.push_back({ std::move(userTables[(size_t)target]), juce::Time::getMillisecondCounter() });
+    
+    userTables[(size_t)target] = std::move(ownedTable);
+    
+    if (onCurvesChanged)
+        onCurvesChanged();
+}
+
+void ResponseCurveSet::reclaimRetiredTables()
+{
+    const auto now = juce::Time::getMillisecondCounter();
+    
+    retiredTables.erase(std::remove_if(retiredTables.begin(), retiredTables.end(),
+                                       [now](const RetiredTable& retired) { return now - retired.retiredAtMs >= reclaimDelayMs; }),
+                        retiredTables.end());
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    Response curves for the mouse expression: how a normalised input (mouse Y
+    position) maps to note velocity, CC1 and CC11.
+    
+    Every curve is a precomputed table - 128 entries for 7-bit MIDI values and
+    1024 interpolated entries for normalised input - so applying one is a table
+    lookup. The built-in shapes are generated at compile time, one table per
+    shape through the CurveFormula template; user curves (piecewise linear or
+    cubic Bezier) are built into the same table type on the message thread.
+*/
+namespace ResponseCurve
+{
+    enum class Shape
+    {
+        Linear,
+        Exponential,    // x^2
+        Logarithmic,    // sqrt(x)
+        SCurve,         // Cubic Bezier, slow at both ends
+        Custom          // User-edited piecewise linear curve
+    };
+    
+    static constexpr int midiTableSize = 128;
+    static constexpr int normalisedTableSize = 1024;
+    
+    /** A fully evaluated curve. Immutable once published. */
+    struct Table
+    {
+        std::array<juce::uint8, midiTableSize> midi {};
+        std::array<float, normalisedTableSize> normalised {};
+        
+        /** Maps a 7-bit value through the curve */
+        int apply(int value) const noexcept
+        {
+            return midi[(size_t)juce::jlimit(0, midiTableSize - 1, value)];
+        }
+        
+        /** Maps a 0-1 value through the curve, interpolating between table entries */
+        float applyNormalised(float value) const noexcept
+        {
+            const float position = juce::jlimit(0.0f, 1.0f, value) * (float)(normalisedTableSize - 1);
+            const auto index = juce::jmin((int)position, normalisedTableSize - 2);
+            const float fraction = position - (float)index;
+            
+            return normalised[(size_t)index] + (normalised[(size_t)index + 1] - normalised[(size_t)index]) * fraction;
+        }
+    };
+    
+    namespace detail
+    {
+        /** Newton-Raphson square root usable in constant expressions */
+        constexpr double constexprSqrt(double x) noexcept
+        {
+            if (x <= 0.0)
+                return 0.0;
+            
+            double estimate = x < 1.0 ? 1.0 : x;
+            
+            for (int i = 0; i < 64; ++i)
+                estimate = 0.5 * (estimate + x / estimate);
+            
+            return estimate;
+        }
+    }
+    
+    /** The formula behind each built-in shape */
+    template <Shape> struct CurveFormula;
+    
+    template <> struct CurveFormula<Shape::Linear>
+    {
+        static constexpr double apply(double x) noexcept { return x; }
+    };
+    
+    template <> struct CurveFormula<Shape::Exponential>
+    {
+        static constexpr double apply(double x) noexcept { return x * x; }
+    };
+    
+    template <> struct CurveFormula<Shape::Logarithmic>
+    {
+        // Approximated with sqrt, as before the tables existed
+        static constexpr double apply(double x) noexcept { return detail::constexprSqrt(x); }
+    };
+    
+    /** Evaluates a formula into a table at compile time */
+    template <Shape CurveShape>
+    constexpr Table makeTable() noexcept
+    {
+        Table table;
+        
+        for (int i = 0; i < midiTableSize; ++i)
+        {
+            const double y = CurveFormula<CurveShape>::apply((double)i / (double)(midiTableSize - 1));
+            table.midi[(size_t)i] = (juce::uint8)(y * (midiTableSize - 1) + 0.5);
+        }
+        
+        for (int i = 0; i < normalisedTableSize; ++i)
+            table.normalised[(size_t)i] = (float)CurveFormula<CurveShape>::apply((double)i / (double)(normalisedTableSize - 1));
+        
+        return table;
+    }
+    
+    /** One table per built-in formula, baked into the binary */
+    template <Shape CurveShape>
+    inline constexpr Table builtInTable = makeTable<CurveShape>();
+    
+    static_assert (builtInTable<Shape::Linear>.midi[127] == 127, "Linear curve must reach full scale");
+    static_assert (builtInTable<Shape::Exponential>.midi[64] == 32, "Exponential curve is x^2");
+    static_assert (builtInTable<Shape::Logarithmic>.midi[32] == 64, "Logarithmic curve is sqrt(x)");
+    
+    /** Builds a table from a piecewise linear curve through the given points (x sorted, both 0-1) */
+    Table makePiecewiseTable(const juce::Array<juce::Point<float>>& points);
+    
+    /** Builds a table from a cubic Bezier from (0,0) to (1,1) with the given control points */
+    Table makeBezierTable(juce::Point<float> control1, juce::Point<float> control2);
+    
+    /** Display name used by the settings UI */
+    juce::String getShapeName(Shape shape);
+}
+
+//==============================================================================
+/**
+    The velocity, CC1 and CC11 curves used by the expression sampling thread.
+    
+    Changing a curve builds its table on the message thread and publishes it with
+    a single pointer swap; readers never lock and never see a half-built table.
+    Replaced user tables are kept for a grace period before being freed.
+*/
+class ResponseCurveSet
+{
+public:
+    enum Target
+    {
+        velocityCurve,
+        modulationCurve,
+        expressionCurve,
+        numTargets
+    };
+    
+    //==============================================================================
+    ResponseCurveSet();
+    ~ResponseCurveSet();
+    
+    /** Selects a built-in shape (message thread) */
+    void setShape(Target target, ResponseCurve::Shape shape);
+    
+    /** Replaces a curve with a user-edited piecewise linear curve (message thread) */
+    void setCustomPoints(Target target, const juce::Array<juce::Point<float>>& points);
+    
+    ResponseCurve::Shape getShape(Target target) const     { return shapes[(size_t)target]; }
+    
+    /** Points of the custom curve (the identity line until edited) */
+    const juce::Array<juce::Point<float>>& getCustomPoints(Target target) const { return customPoints[(size_t)target]; }
+    
+    /** The current table for a target - wait-free, any thread */
+    const ResponseCurve::Table& getTable(Target target) const noexcept
+    {
+        return *tables[(size_t)target].load(std::memory_order_acquire);
+    }
+    
+    /** Called on the message thread after any curve changes */
+    std::function<void()> onCurvesChanged;
+
+private:
+    struct RetiredTable
+    {
+        std::unique_ptr<ResponseCurve::Table> table;
+        juce::uint32 retiredAtMs = 0;
+    };
+    
+    static constexpr juce::uint32 reclaimDelayMs = 2000;
+    
+    std::array<std::atomic<const ResponseCurve::Table*>, numTargets> tables;
+    std::array<std::unique_ptr<ResponseCurve::Table>, numTargets> userTables;
+    std::vector<RetiredTable> retiredTables;
+    
+    std::array<ResponseCurve::Shape, numTargets> shapes;
+    std::array<juce::Array<juce::Point<float>>, numTargets> customPoints;
+    
+    void publish(Target target, const ResponseCurve::Table* table, std::unique_ptr<ResponseCurve::Table> ownedTable);
+    void reclaimRetiredTables();
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ResponseCurveSet)
+};
@@ -0,0 +1,131 @@
+#include "ResponseCurveEditor.h"
+
+//==============================================================================
+ResponseCurveEditor::ResponseCurveEditor(ResponseCurveSet& curveSet, ResponseCurveSet::Target curveTarget)
+    : curves(curveSet), target(curveTarget)
+{
+    setSize(110, 110);
+}
+
+ResponseCurveEditor::~ResponseCurveEditor()
+{
+}
+
+//==============================================================================
+void ResponseCurveEditor::paint(juce::Graphics& g)
+{
+    const auto area = getPlotArea();
+    
+    g.setColour(juce::Colours::black);
+    g.fillRect(area);
+    
+    // Quarter grid
+    g.setColour(juce::Colours::white.withAlpha(0.1f));
+    
+    for (int i = 1; i < 4; ++i)
+    {
+        g.drawVerticalLine((int)(area.getX() + area.getWidth() * (float)i / 4.0f), area.getY(), area.getBottom());
+        g.drawHorizontalLine((int)(area.getY() + area.getHeight() * (float)i / 4.0f), area.getX(), area.getRight());
+    }
+    
+    // The curve, straight from the table the expression thread uses
+    const auto& table = curves.getTable(target);
+    const int numSegments = (int)area.getWidth();
+    juce::Path path;
+    
+    for (int i = 0; i <= numSegments; ++i)
+    {
+        const float x = (float)i / (float)numSegments;
+        const auto point = toScreen({ x, table.applyNormalised(x) });
+        
+        if (i == 0)
+            path.startNewSubPath(point);
+        else
+            path.lineTo(point);
+    }
+    
+    g.setColour(juce::Colours::lightgreen);
+    g.strokePath(path, juce::PathStrokeType(1.5f));
+    
+    // Breakpoints
+    const bool isCustom = curves.getShape(target) == ResponseCurve::Shape::Custom;
+    g.setColour(isCustom ? juce::Colours::orange : juce::Colours::grey);
+    
+    for (const auto& point : getEditablePoints())
+    {
+        const auto centre = toScreen(point);
+        g.fillEllipse(centre.x - pointRadius, centre.y - pointRadius, pointRadius * 2.0f, pointRadius * 2.0f);
+    }
+    
+    g.setColour(juce::Colours::grey);
+    g.drawRect(area);
+}
+
+void ResponseCurveEditor::mouseDown(const juce::MouseEvent& event)
+{
+    // Pick the breakpoint nearest the click horizontally
+    const auto points = getEditablePoints();
+    float nearestDistance = std::numeric_limits<float>::max();
+    
+    for (int i = 0; i < points.size(); ++i)
+    {
+        const float distance = std::abs(toScreen(points[i]).x - event.position.x);
+        
+        if (distance < nearestDistance)
+        {
+            nearestDistance = distance;
+            draggedPoint = i;
+        }
+    }
+    
+    mouseDrag(event);
+}
+
+void ResponseCurveEditor::mouseDrag(const juce::MouseEvent& event)
+{
+    auto points = getEditablePoints();
+    
+    if (!juce::isPositiveAndBelow(draggedPoint, points.size()))
+        return;
+    
+    // Breakpoints keep their x position and only move vertically
+    const auto area = getPlotArea();
+    const float y = juce::jlimit(0.0f, 1.0f, (area.getBottom() - event.position.y) / area.getHeight());
+    
+    points.getReference(draggedPoint).y = y;
+    curves.setCustomPoints(target, points);
+    repaint();
+}
+
+void ResponseCurveEditor::mouseUp(const juce::MouseEvent&)
+{
+    draggedPoint = -1;
+}
+
+//==============================================================================
+juce::Rectangle<float> ResponseCurveEditor::getPlotArea() const
+{
+    return getLocalBounds().toFloat().reduced(pointRadius + 1.0f);
+}
+
+juce::Point<float> ResponseCurveEditor::toScreen(juce::Point<float> curvePoint) const
+{
+    const auto area = getPlotArea();
+    return { area.getX() + curvePoint.x * area.getWidth(),
+             area.getBottom() - curvePoint.y * area.getHeight() };
+}
+
+juce::Array<juce::Point<float>> ResponseCurveEditor::getEditablePoints() const
+{
+    auto points = curves.getCustomPoints(target);
+    
+    if (curves.getShape(target) != ResponseCurve::Shape::Custom)
+    {
+        const auto& table = curves.getTable(target);
+        
+        for (auto& point : points)
+            point.y = table.applyNormalised(point.x);
+    }
+    
+    return points;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ResponseCurve.h"
+
+//==============================================================================
+/**
+    Draws one response curve and lets the user reshape it by dragging its
+    breakpoints up and down. Dragging turns the curve into a custom piecewise
+    linear curve, starting from the shape that was selected.
+*/
+class ResponseCurveEditor : public juce::Component
+{
+public:
+    ResponseCurveEditor(ResponseCurveSet& curveSet, ResponseCurveSet::Target curveTarget);
+    ~ResponseCurveEditor() override;
+    
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+    void mouseDrag(const juce::MouseEvent& event) override;
+    void mouseUp(const juce::MouseEvent& event) override;
+
+private:
+    ResponseCurveSet& curves;
+    const ResponseCurveSet::Target target;
+    
+    int draggedPoint = -1;
+    static constexpr float pointRadius = 4.0f;
+    
+    juce::Rectangle<float> getPlotArea() const;
+    juce::Point<float> toScreen(juce::Point<float> curvePoint) const;
+    
+    /** The breakpoints to drag: the custom points, or the selected shape sampled at their positions */
+    juce::Array<juce::Point<float>> getEditablePoints() const;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ResponseCurveEditor)
+};
@@ -1,4 +1,25 @@
 #include "StradellaKeyboardMapper.h"
+#include "KeyboardLayoutFile.h"
+
+//==============================================================================
+void StradellaKeyboardMapper::CompiledLayout::setKey(int keyCode, KeyType type, std::initializer_list<int> midiNotes) noexcept
+{
+    if (!isValidKeyCode(keyCode))
+    {
+        jassertfalse;
+        return;
+    }
+    
+    auto& entry = keys[(size_t)keyCode];
+    entry.type = type;
+    entry.midiNotes = {};
+    
+    for (int note : midiNotes)
+    {
+        if (entry.midiNotes.numNotes < maxNotesPerKey)
+            entry.midiNotes.notes[(size_t)entry.midiNotes.numNotes++] = (juce::uint8)juce::jlimit(0, 127, note);
+    }
+}
 
 //==============================================================================
 StradellaKeyboardMapper::StradellaKeyboardMapper()
@@ -6,122 +27,267 @@ StradellaKeyboardMapper::StradellaKeyboardMapper()
     loadDefaultConfiguration();
 }
 
+StradellaKeyboardMapper::~StradellaKeyboardMapper()
+{
+    stopTimer();
+}
+
 void StradellaKeyboardMapper::loadDefaultConfiguration()
 {
-    setupDefaultMappings();
+    applyLayout(createDefaultLayout());
+}
+
+juce::File StradellaKeyboardMapper::getUserConfigurationFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("straDellaMIDI")
+               .getChildFile("keyboard_mapping.txt");
 }
 
-void StradellaKeyboardMapper::setupDefaultMappings()
+StradellaKeyboardMapper::CompiledLayout StradellaKeyboardMapper::createDefaultLayout()
 {
-    keyMappings.clear();
+    using Row = StradellaLayout::Row;
     
-    // Row 1: Single notes in cycle of fifths (a,s,d,f,g,h,j,k,l,;)
-    // All notes in Octave 1 (MIDI 24-35) as per Stradella bass system
-    // F key = C1 (MIDI note 24)
-    // Cycle of fifths: each step is +7 semitones (or -5 going backwards)
-    // Since we're limited to octave 1, we wrap around within the octave
+    // Each keyboard row covers ten neighbouring columns of the 120-bass layout,
+    // running round the cycle of fifths from Eb to F#
+    const int firstColumn = StradellaLayout::getColumnForPitchClass(3); // Eb
     
-    // Mapping for single note row (a,s,d,f,g,h,j,k,l,;) - removed apostrophe
-    juce::Array<int> singleNoteKeys = { 'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ';' };
+    struct RowBinding
+    {
+        const char* keys;
+        Row row;
+    };
     
-    // Cycle of fifths within octave 1 (all notes MIDI 24-35)
-    // A, S, D, F, G, H, J, K, L, ;
-    // Cycle of fifths pattern: Eb, Bb, F, C, G, D, A, E, B, F#
-    juce::Array<int> singleNoteMidiValues = { 27, 34, 29, 24, 31, 26, 33, 28, 35, 30 }; // Octave 1 notes
+    static constexpr RowBinding rowBindings[] =
+    {
+        { "ASDFGHJKL;", Row::FundamentalBass },  // Single notes in octave 1 (F key = C1)
+        { "ZXCVBNM,./", Row::CounterBass },      // Major third above the single notes
+        { "QWERTYUIOP", Row::Major },            // Major triads in octave 2
+        { "1234567890", Row::Minor }             // Minor triads in octave 2
+    };
     
-    for (int i = 0; i < singleNoteKeys.size(); ++i)
+    CompiledLayout defaults;
+    
+    for (const auto& binding : rowBindings)
     {
-        KeyMapping mapping;
-        mapping.keyCode = singleNoteKeys[i];
-        mapping.type = KeyType::SingleNote;
-        mapping.midiNotes.add(singleNoteMidiValues[i]);
-        mapping.description = getMidiNoteName(singleNoteMidiValues[i]);
-        keyMappings.set(mapping.keyCode, mapping);
+        for (int i = 0; binding.keys[i] != 0; ++i)
+            defaults.bindKeyToCell(binding.keys[i], binding.row, firstColumn + i);
     }
     
-    // Row 2: Third above (z,x,c,v,b,n,m,comma,period,slash)
-    // These are a major third (4 semitones) above the corresponding single notes
-    // Also keeping within octave 1
-    juce::Array<int> thirdNoteKeys = { 'Z', 'X', 'C', 'V', 'B', 'N', 'M', ',', '.', '/' };
+    return defaults;
+}
+
+void StradellaKeyboardMapper::CompiledLayout::bindKeyToCell(int keyCode, StradellaLayout::Row row, int column) noexcept
+{
+    if (!isValidKeyCode(keyCode) || !juce::isPositiveAndBelow(column, StradellaLayout::numColumns))
+    {
+        jassertfalse;
+        return;
+    }
+    
+    auto& entry = keys[(size_t)keyCode];
+    entry.type = getKeyTypeForRow(row);
+    entry.midiNotes = getNotesForCell(row, column);
+}
+
+StradellaKeyboardMapper::NoteList StradellaKeyboardMapper::getNotesForCell(StradellaLayout::Row row, int column) noexcept
+{
+    static_assert(StradellaLayout::maxNotesPerCell <= maxNotesPerKey, "Every button must fit in a key entry");
+    
+    NoteList result;
+    
+    if (!juce::isPositiveAndBelow(column, StradellaLayout::numColumns))
+        return result;
     
-    // Third notes - major third above, wrapping to stay in octave 1
-    juce::Array<int> thirdNoteMidiValues = { 31, 26, 33, 28, 35, 30, 25, 32, 27, 34 }; // Octave 1 notes
+    const auto& cell = StradellaLayout::getCell(row, column);
     
-    for (int i = 0; i < thirdNoteKeys.size(); ++i)
+    for (int i = 0; i < cell.numNotes; ++i)
+        result.notes[(size_t)i] = cell.notes[(size_t)i];
+    
+    result.numNotes = cell.numNotes;
+    return result;
+}
+
+StradellaKeyboardMapper::KeyType StradellaKeyboardMapper::getKeyTypeForRow(StradellaLayout::Row row) noexcept
+{
+    switch (row)
     {
-        KeyMapping mapping;
-        mapping.keyCode = thirdNoteKeys[i];
-        mapping.type = KeyType::ThirdNote;
-        mapping.midiNotes.add(thirdNoteMidiValues[i]);
-        mapping.description = getMidiNoteName(thirdNoteMidiValues[i]);
-        keyMappings.set(mapping.keyCode, mapping);
+        case StradellaLayout::Row::CounterBass:     return KeyType::ThirdNote;
+        case StradellaLayout::Row::FundamentalBass: return KeyType::SingleNote;
+        case StradellaLayout::Row::Major:           return KeyType::MajorChord;
+        case StradellaLayout::Row::Minor:           return KeyType::MinorChord;
+        case StradellaLayout::Row::Dominant7th:     return KeyType::Dominant7Chord;
+        case StradellaLayout::Row::Diminished:      return KeyType::DiminishedChord;
+        default:                                    return KeyType::SingleNote;
     }
+}
+
+void StradellaKeyboardMapper::applyLayout(const CompiledLayout& newLayout)
+{
+    auto newSet = buildSnapshotSet(newLayout);
     
-    // Row 3: Major triads (q,w,e,r,t,y,u,i,o,p)
-    // Major triad: root, major third (+4), perfect fifth (+7)
-    // All notes in Octave 2 (MIDI 36-47) as per Stradella bass system
-    // Cycle of fifths starting from Eb: Eb, Bb, F, C, G, D, A, E, B, F#
-    juce::Array<int> majorChordKeys = { 'Q', 'W', 'E', 'R', 'T', 'Y', 'U', 'I', 'O', 'P' };
-    juce::Array<int> majorChordRoots = { 39, 46, 41, 36, 43, 38, 45, 40, 47, 42 }; // Eb2, Bb2, F2, C2, G2, D2, A2, E2, B2, F#2
+    // Keep the old tables alive until nobody can still be reading them
+    if (activeSet != nullptr)
+        retiredSets.add(activeSet.release());
     
-    for (int i = 0; i < majorChordKeys.size() && i < majorChordRoots.size(); ++i)
+    activeSet = std::move(newSet);
+    publishCurrentSnapshot();
+    
+    // Usually nobody is mid-lookup and the old set goes straight away; otherwise the timer retries
+    reclaimRetiredSets();
+}
+
+void StradellaKeyboardMapper::setTranspose(int semitones)
+{
+    semitones = juce::jlimit(-maxTransposeSemitones, maxTransposeSemitones, semitones);
+    
+    if (semitones == transposeSemitones)
+        return;
+    
+    transposeSemitones = semitones;
+    publishCurrentSnapshot();
+}
+
+void StradellaKeyboardMapper::publishCurrentSnapshot()
+{
+    jassert(activeSet != nullptr);
+    
+    const auto& snapshot = activeSet->transpositions[(size_t)(transposeSemitones + maxTransposeSemitones)];
+    currentSnapshot.store(&snapshot);
+    
+    // The timer drives both file watching and deferred reclamation
+    if (!retiredSets.isEmpty() && !isTimerRunning())
+        startTimer(fileCheckIntervalMs);
+    
+    if (onLayoutChanged)
+        onLayoutChanged();
+}
+
+std::unique_ptr<StradellaKeyboardMapper::SnapshotSet> StradellaKeyboardMapper::buildSnapshotSet(const CompiledLayout& baseLayout)
+{
+    auto set = std::make_unique<SnapshotSet>();
+    
+    for (int i = 0; i < numTranspositions; ++i)
     {
-        KeyMapping mapping;
-        mapping.keyCode = majorChordKeys[i];
-        mapping.type = KeyType::MajorChord;
-        int root = majorChordRoots[i];
-        mapping.midiNotes.add(root);        // Root
-        mapping.midiNotes.add(root + 4);    // Major third
-        mapping.midiNotes.add(root + 7);    // Perfect fifth
-        mapping.description = getMidiNoteName(root) + " Major";
-        keyMappings.set(mapping.keyCode, mapping);
+        const int semitones = i - maxTransposeSemitones;
+        auto& snapshot = set->transpositions[(size_t)i];
+        std::array<bool, 128> usedNotes {};
+        
+        for (int keyCode = 0; keyCode < numKeyCodes; ++keyCode)
+        {
+            const auto& source = baseLayout.keys[(size_t)keyCode];
+            auto& entry = snapshot.layout.keys[(size_t)keyCode];
+            entry.type = source.type;
+            
+            for (int note : source.midiNotes)
+            {
+                const int transposed = note + semitones;
+                
+                if (transposed >= 0 && transposed <= 127)
+                {
+                    entry.midiNotes.notes[(size_t)entry.midiNotes.numNotes++] = (juce::uint8)transposed;
+                    usedNotes[(size_t)transposed] = true;
+                }
+            }
+            
+            snapshot.size.numKeyNotes += entry.midiNotes.numNotes;
+            snapshot.keyDescriptions[(size_t)keyCode] = describeKey(entry);
+        }
+        
+        snapshot.size.polyphony = (int)std::count(usedNotes.begin(), usedNotes.end(), true);
     }
     
-    // Row 4: Minor triads (1,2,3,4,5,6,7,8,9,0)
-    // Minor triad: root, minor third (+3), perfect fifth (+7)
-    // All notes in Octave 2 (MIDI 36-47) as per Stradella bass system
-    // Cycle of fifths starting from Eb: Eb, Bb, F, C, G, D, A, E, B, F#
-    juce::Array<int> minorChordKeys = { '1', '2', '3', '4', '5', '6', '7', '8', '9', '0' };
-    juce::Array<int> minorChordRoots = { 39, 46, 41, 36, 43, 38, 45, 40, 47, 42 }; // Eb2, Bb2, F2, C2, G2, D2, A2, E2, B2, F#2
+    return set;
+}
+
+void StradellaKeyboardMapper::reclaimRetiredSets()
+{
+    // Retired sets were unpublished before this check, so a lookup that starts now can't reach them
+    if (numActiveReaders.load() == 0)
+        retiredSets.clear();
+}
+
+void StradellaKeyboardMapper::watchConfigurationFile(const juce::File& configFile)
+{
+    watchedFile = configFile;
+    watchedFileModificationTime = configFile.getLastModificationTime();
+    startTimer(fileCheckIntervalMs);
+}
+
+void StradellaKeyboardMapper::timerCallback()
+{
+    reclaimRetiredSets();
     
-    for (int i = 0; i < minorChordKeys.size() && i < minorChordRoots.size(); ++i)
+    if (watchedFile != juce::File())
+    {
+        const auto modificationTime = watchedFile.getLastModificationTime();
+        
+        if (modificationTime != watchedFileModificationTime)
+        {
+            watchedFileModificationTime = modificationTime;
+            
+            // A deleted mapping file means "back to the built-in layout"
+            if (!watchedFile.existsAsFile())
+                loadDefaultConfiguration();
+            else if (!loadConfiguration(watchedFile))
+                juce::Logger::writeToLog("Keeping previous keyboard mapping");
+        }
+    }
+    else if (retiredSets.isEmpty())
     {
-        KeyMapping mapping;
-        mapping.keyCode = minorChordKeys[i];
-        mapping.type = KeyType::MinorChord;
-        int root = minorChordRoots[i];
-        mapping.midiNotes.add(root);        // Root
-        mapping.midiNotes.add(root + 3);    // Minor third
-        mapping.midiNotes.add(root + 7);    // Perfect fifth
-        mapping.description = getMidiNoteName(root) + " Minor";
-        keyMappings.set(mapping.keyCode, mapping);
+        stopTimer();
     }
 }
 
-juce::Array<int> StradellaKeyboardMapper::getMidiNotesForKey(int keyCode, bool& isValidKey) const
+juce::String StradellaKeyboardMapper::describeKey(const KeyEntry& entry)
 {
-    if (keyMappings.contains(keyCode))
+    if (entry.midiNotes.isEmpty())
+        return {};
+    
+    const auto rootName = getMidiNoteName(entry.midiNotes[0]);
+    
+    switch (entry.type)
     {
-        isValidKey = true;
-        return keyMappings[keyCode].midiNotes;
+        case KeyType::MajorChord:
+            return rootName + " Major";
+        case KeyType::MinorChord:
+            return rootName + " Minor";
+        case KeyType::Dominant7Chord:
+            return rootName + " 7th";
+        case KeyType::DiminishedChord:
+            return rootName + " Dim";
+        case KeyType::SingleNote:
+        case KeyType::ThirdNote:
+        default:
+            return rootName;
     }
+}
+
+StradellaKeyboardMapper::NoteList StradellaKeyboardMapper::getMidiNotesForKey(int keyCode) const noexcept
+{
+    if (isValidKeyCode(keyCode))
+        return readSnapshot([keyCode](const Snapshot& snapshot) { return snapshot.layout.keys[(size_t)keyCode].midiNotes; });
     
-    isValidKey = false;
     return {};
 }
 
-StradellaKeyboardMapper::KeyType StradellaKeyboardMapper::getKeyType(int keyCode) const
+StradellaKeyboardMapper::LayoutSize StradellaKeyboardMapper::getLayoutSize() const noexcept
 {
-    if (keyMappings.contains(keyCode))
-        return keyMappings[keyCode].type;
+    return readSnapshot([](const Snapshot& snapshot) { return snapshot.size; });
+}
+
+StradellaKeyboardMapper::KeyType StradellaKeyboardMapper::getKeyType(int keyCode) const noexcept
+{
+    if (isValidKeyCode(keyCode))
+        return readSnapshot([keyCode](const Snapshot& snapshot) { return snapshot.layout.keys[(size_t)keyCode].type; });
     
     return KeyType::SingleNote; // Default
 }
 
 juce::String StradellaKeyboardMapper::getKeyDescription(int keyCode) const
 {
-    if (keyMappings.contains(keyCode))
-        return keyMappings[keyCode].description;
+    if (isValidKeyCode(keyCode))
+        return readSnapshot([keyCode](const Snapshot& snapshot) { return snapshot.keyDescriptions[(size_t)keyCode]; });
     
     return {};
 }
@@ -141,8 +307,25 @@ bool StradellaKeyboardMapper::loadConfiguration(const juce::File& configFile)
     if (!configFile.existsAsFile())
         return false;
     
-    // TODO: Implement configuration file parsing
-    // For now, just use default configuration
-    loadDefaultConfiguration();
+    CompiledLayout newLayout;
+    const auto cacheFile = KeyboardLayoutFile::getCompiledImageFile(configFile);
+    
+    // Fast path: a valid compiled image of this exact file already exists
+    if (!KeyboardLayoutFile::loadCompiledImage(cacheFile, configFile, newLayout))
+    {
+        juce::String errorMessage;
+        
+        if (!KeyboardLayoutFile::parse(configFile, createDefaultLayout(), newLayout, errorMessage))
+        {
+            juce::Logger::writeToLog("Could not load keyboard mapping " + configFile.getFullPathName()
+                                     + ": " + errorMessage);
+            return false;
+        }
+        
+        if (!KeyboardLayoutFile::writeCompiledImage(cacheFile, configFile, newLayout))
+            juce::Logger::writeToLog("Could not write compiled keyboard mapping " + cacheFile.getFullPathName());
+    }
+    
+    applyLayout(newLayout);
     return true;
 }
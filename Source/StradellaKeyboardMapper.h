@@ -1,13 +1,25 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "StradellaLayout.h"
 
 //==============================================================================
 /**
     Maps computer keyboard keys to MIDI notes based on Stradella accordion layout.
     Supports loading configuration from a text file for flexible key mappings.
+    
+    Lookups go through a flat table indexed directly by key code, so the key
+    press path never allocates or hashes. Descriptions live in a separate
+    table because only the GUI needs them.
+    
+    The tables are immutable snapshots published through an atomic pointer:
+    reloading, transposing or shifting octaves builds (or selects) a new
+    snapshot and swaps it in, so readers never see a half-updated table.
+    Every lookup copies its result out while counted as an active reader, and
+    a replaced snapshot set is freed on the message thread once no lookup is
+    in progress.
 */
-class StradellaKeyboardMapper
+class StradellaKeyboardMapper : private juce::Timer
 {
 public:
     enum class KeyType
@@ -15,42 +27,166 @@ public:
         SingleNote,      // Row: a,s,d,f,g,h,j,k (cycle of fifths)
         ThirdNote,       // Row: z,x,c,v,b,n,m (third above)
         MajorChord,      // Row: q,w,e,r,t,y,u,i,o,p
-        MinorChord       // Row: 1,2,3,4,5,6,7
+        MinorChord,      // Row: 1,2,3,4,5,6,7
+        Dominant7Chord,  // Not bound by default
+        DiminishedChord  // Not bound by default
+    };
+    
+    static constexpr int maxNotesPerKey = 4;
+    static constexpr int numKeyCodes = 256;
+    static constexpr int maxTransposeSemitones = 12;
+    
+    /** Fixed-size list of the MIDI notes produced by one key (trivially copyable, no heap) */
+    struct NoteList
+    {
+        std::array<juce::uint8, maxNotesPerKey> notes {};
+        int numNotes = 0;
+        
+        const juce::uint8* begin() const noexcept { return notes.data(); }
+        const juce::uint8* end() const noexcept   { return notes.data() + numNotes; }
+        int size() const noexcept                 { return numNotes; }
+        bool isEmpty() const noexcept             { return numNotes == 0; }
+        int operator[](int index) const noexcept  { return notes[(size_t)index]; }
+    };
+    
+    /** One slot of the lookup table */
+    struct KeyEntry
+    {
+        NoteList midiNotes;
+        KeyType type = KeyType::SingleNote;
+    };
+    
+    /** How many notes a layout can play at once, for sizing per-block output */
+    struct LayoutSize
+    {
+        int numKeyNotes = 0;    // Notes over all mapped keys (a note shared by two keys counts twice)
+        int polyphony = 0;      // Distinct notes
+    };
+    
+    /** The complete compiled key table. Plain data, so it can be cached as a binary image. */
+    struct CompiledLayout
+    {
+        std::array<KeyEntry, numKeyCodes> keys {};
+        
+        /** Sets a key's type and notes (notes beyond maxNotesPerKey are ignored) */
+        void setKey(int keyCode, KeyType type, std::initializer_list<int> midiNotes) noexcept;
+        
+        /** Binds a key to a button of the 120-bass layout */
+        void bindKeyToCell(int keyCode, StradellaLayout::Row row, int column) noexcept;
     };
 
     //==============================================================================
     StradellaKeyboardMapper();
+    ~StradellaKeyboardMapper() override;
     
-    /** Loads keyboard mappings from a configuration file */
+    /** Loads keyboard mappings from a configuration file.
+        A compiled binary image of the file is cached, so later loads skip parsing.
+    */
     bool loadConfiguration(const juce::File& configFile);
     
     /** Loads default keyboard mappings */
     void loadDefaultConfiguration();
     
-    /** Gets MIDI notes for a given key press */
-    juce::Array<int> getMidiNotesForKey(int keyCode, bool& isValidKey) const;
+    /** Location of the user's mapping file (it does not have to exist) */
+    static juce::File getUserConfigurationFile();
+    
+    /** Reloads the given file whenever it changes on disk (message thread only) */
+    void watchConfigurationFile(const juce::File& configFile);
+    
+    /** Transposes every key by a number of semitones (clamped to +/- maxTransposeSemitones).
+        All transpositions are precomputed, so this is just a pointer swap.
+        Notes that would fall outside the MIDI range are dropped.
+    */
+    void setTranspose(int semitones);
+    
+    /** Gets the current transposition in semitones */
+    int getTranspose() const noexcept { return transposeSemitones; }
+    
+    /** Called on the message thread after the active layout or transposition changed */
+    std::function<void()> onLayoutChanged;
+    
+    /** Gets MIDI notes for a given key press (any thread).
+        Returns a copy from the current snapshot - empty if the key is not mapped.
+    */
+    NoteList getMidiNotesForKey(int keyCode) const noexcept;
+    
+    /** Size of the current layout at the current transposition (any thread) */
+    LayoutSize getLayoutSize() const noexcept;
+    
+    /** Returns true if the key produces any notes */
+    bool isKeyMapped(int keyCode) const noexcept { return !getMidiNotesForKey(keyCode).isEmpty(); }
     
     /** Gets the key type for a given key code */
-    KeyType getKeyType(int keyCode) const;
+    KeyType getKeyType(int keyCode) const noexcept;
     
     /** Gets a human-readable name for a MIDI note number */
     static juce::String getMidiNoteName(int midiNoteNumber);
     
     /** Gets a human-readable description for a key */
     juce::String getKeyDescription(int keyCode) const;
+    
+    /** Builds the built-in Stradella layout */
+    static CompiledLayout createDefaultLayout();
+    
+    /** Gets the notes of a button of the 120-bass layout, addressed by row and column */
+    static NoteList getNotesForCell(StradellaLayout::Row row, int column) noexcept;
+    
+    /** The key type used for keys bound to a given layout row */
+    static KeyType getKeyTypeForRow(StradellaLayout::Row row) noexcept;
 
 private:
-    struct KeyMapping
+    static constexpr int numTranspositions = 2 * maxTransposeSemitones + 1;
+    static constexpr int fileCheckIntervalMs = 1000;
+    
+    /** One immutable, fully built table */
+    struct Snapshot
     {
-        int keyCode;
-        KeyType type;
-        juce::Array<int> midiNotes;
-        juce::String description;
+        // Hot data: read on every key press, release and bellows retrigger
+        CompiledLayout layout;
+        LayoutSize size;
+        
+        // Cold data: only needed by the GUI
+        std::array<juce::String, numKeyCodes> keyDescriptions;
     };
     
-    juce::HashMap<int, KeyMapping> keyMappings;
+    /** A layout together with all of its precomputed transpositions */
+    struct SnapshotSet
+    {
+        std::array<Snapshot, numTranspositions> transpositions;
+    };
+    
+    std::unique_ptr<SnapshotSet> activeSet;                 // Owned by the message thread
+    std::atomic<const Snapshot*> currentSnapshot { nullptr };
+    mutable std::atomic<int> numActiveReaders { 0 };
+    int transposeSemitones = 0;
+    
+    juce::OwnedArray<SnapshotSet> retiredSets;              // Waiting for the lookups in progress to finish
+    
+    juce::File watchedFile;
+    juce::Time watchedFileModificationTime;
+    
+    void timerCallback() override;
+    void applyLayout(const CompiledLayout& newLayout);
+    void publishCurrentSnapshot();
+    void reclaimRetiredSets();
+    
+    static std::unique_ptr<SnapshotSet> buildSnapshotSet(const CompiledLayout& baseLayout);
+    static juce::String describeKey(const KeyEntry& entry);
+    
+    /** Calls the function with the current snapshot and returns its result, which must be a copy.
+        Readers are counted before the pointer is loaded, so a set retired before the count was
+        last seen at zero can't be in use.
+    */
+    template <typename Function>
+    auto readSnapshot(Function&& function) const noexcept
+    {
+        numActiveReaders.fetch_add(1);
+        const auto result = function(*currentSnapshot.load());
+        numActiveReaders.fetch_sub(1);
+        return result;
+    }
     
-    void setupDefaultMappings();
+    static bool isValidKeyCode(int keyCode) noexcept { return keyCode >= 0 && keyCode < numKeyCodes; }
     
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (StradellaKeyboardMapper)
 };
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+//==============================================================================
+/**
+    The full 120-bass Stradella system, generated at compile time from the
+    cycle of fifths.
+    
+    The layout is 20 columns (Fb at column 0 through E# at column 19, with C at
+    column 8) by 6 rows. Bass rows sit in octave 1 (MIDI 24-35) and chord rows
+    are voiced upwards from a root in octave 2 (MIDI 36-47). The seventh and
+    diminished rows use the standard reduced three-note voicings without the fifth.
+    
+    Everything here is constexpr, so the tables cost nothing at startup.
+*/
+namespace StradellaLayout
+{
+    enum class Row
+    {
+        CounterBass,        // Major third above the fundamental bass
+        FundamentalBass,    // Cycle of fifths
+        Major,              // Root, major third, fifth
+        Minor,              // Root, minor third, fifth
+        Dominant7th,        // Root, major third, minor seventh
+        Diminished          // Root, minor third, diminished seventh
+    };
+    
+    static constexpr int numRows = 6;
+    static constexpr int numColumns = 20;
+    static constexpr int maxNotesPerCell = 3;
+    
+    static constexpr int cColumn = 8;           // Column of the C fundamental
+    static constexpr int bassOctaveBase = 24;   // C1
+    static constexpr int chordOctaveBase = 36;  // C2
+    
+    /** The notes played by one button */
+    struct Cell
+    {
+        std::array<juce::uint8, maxNotesPerCell> notes {};
+        int numNotes = 0;
+    };
+    
+    /** Pitch class (0 = C) of a column's fundamental: one fifth per column */
+    constexpr int getRootPitchClass(int column) noexcept
+    {
+        return (((column - cColumn) * 7) % 12 + 12) % 12;
+    }
+    
+    /** Column whose fundamental has the given pitch class (the one nearest C) */
+    constexpr int getColumnForPitchClass(int pitchClass) noexcept
+    {
+        for (int column = cColumn - 6; column < cColumn + 6; ++column)
+            if (getRootPitchClass(column) == ((pitchClass % 12) + 12) % 12)
+                return column;
+        
+        return cColumn;
+    }
+    
+    namespace detail
+    {
+        constexpr Cell makeCell(std::initializer_list<int> notes) noexcept
+        {
+            Cell cell;
+            
+            for (int note : notes)
+                cell.notes[(size_t)cell.numNotes++] = (juce::uint8)note;
+            
+            return cell;
+        }
+        
+        constexpr Cell makeCell(Row row, int column) noexcept
+        {
+            const int pitchClass = getRootPitchClass(column);
+            const int bass = bassOctaveBase + pitchClass;
+            const int chordRoot = chordOctaveBase + pitchClass;
+            
+            switch (row)
+            {
+                case Row::CounterBass:      return makeCell({ bassOctaveBase + (pitchClass + 4) % 12 });
+                case Row::FundamentalBass:  return makeCell({ bass });
+                case Row::Major:            return makeCell({ chordRoot, chordRoot + 4, chordRoot + 7 });
+                case Row::Minor:            return makeCell({ chordRoot, chordRoot + 3, chordRoot + 7 });
+                case Row::Dominant7th:      return makeCell({ chordRoot, chordRoot + 4, chordRoot + 10 });
+                case Row::Diminished:       return makeCell({ chordRoot, chordRoot + 3, chordRoot + 9 });
+                default:                    return {};
+            }
+        }
+        
+        constexpr std::array<std::array<Cell, numColumns>, numRows> makeTable() noexcept
+        {
+            std::array<std::array<Cell, numColumns>, numRows> table {};
+            
+            for (int row = 0; row < numRows; ++row)
+                for (int column = 0; column < numColumns; ++column)
+                    table[(size_t)row][(size_t)column] = makeCell((Row)row, column);
+            
+            return table;
+        }
+    }
+    
+    /** All 120 buttons, indexed [row][column] */
+    inline constexpr auto cells = detail::makeTable();
+    
+    /** Gets the notes for a button */
+    constexpr const Cell& getCell(Row row, int column) noexcept
+    {
+        return cells[(size_t)row][(size_t)column];
+    }
+    
+    // Sanity checks against the traditional layout
+    static_assert(getCell(Row::FundamentalBass, cColumn).notes[0] == 24, "C fundamental is C1");
+    static_assert(getCell(Row::CounterBass, cColumn).notes[0] == 28, "C counterbass is E1");
+    static_assert(getCell(Row::Major, cColumn + 1).notes[0] == 43, "Column right of C is G");
+    static_assert(getCell(Row::Minor, 5).notes[1] == 42, "Eb minor has a Gb");
+    static_assert(getCell(Row::Dominant7th, cColumn).notes[2] == 46, "C7 has a Bb");
+    static_assert(getCell(Row::Diminished, cColumn).notes[2] == 45, "Cdim has a Bbb");
+}
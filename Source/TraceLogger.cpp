@@ -0,0 +1,144 @@
+#include "TraceLogger.h"
+
+//==============================================================================
+JUCE_IMPLEMENT_SINGLETON (TraceLogger)
+
+TraceLogger::TraceLogger()
+    : juce::Thread("Trace Logger"),
+      ring(std::make_unique<MpscRing<Record, ringCapacity>>())
+{
+    startThread();
+}
+
+TraceLogger::~TraceLogger()
+{
+    // Stopping the thread writes out whatever is still in the ring
+    stopThread(2000);
+    clearSingletonInstance();
+}
+
+//==============================================================================
+void TraceLogger::trace(Level eventLevel, Event event, int arg1, int arg2, int arg3) noexcept
+{
+    if (!isEnabled(eventLevel))
+        return;
+    
+    // A full ring means the background thread is behind: the record is dropped and counted
+    ring->push({ juce::Time::getHighResolutionTicks(), { arg1, arg2, arg3 }, event, eventLevel });
+}
+
+//==============================================================================
+juce::File TraceLogger::getLogFile()
+{
+    return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+               .getChildFile("straDellaMIDI")
+               .getChildFile("Logs")
+               .getChildFile("trace.log");
+}
+
+juce::String TraceLogger::getLevelName(Level levelToName)
+{
+    switch (levelToName)
+    {
+        case Level::off:        return "Off";
+        case Level::error:      return "Error";
+        case Level::info:       return "Info";
+        case Level::debug:      return "Debug";
+        case Level::verbose:    return "Verbose";
+        default:                return {};
+    }
+}
+
+const char* TraceLogger::getEventFormat(Event event) noexcept
+{
+    // $1-$3 are replaced by the record's arguments
+    switch (event)
+    {
+        case Event::modulationTarget:   return "CC1 (Modulation) target: value=$1";
+        case Event::expressionTarget:   return "CC11 (Expression) target: value=$1";
+        case Event::bellowsReversal:    return "Bellows reversal: velocity=$1";
+        case Event::keyPressed:         return "Key pressed: keyCode=$1 notes=$2 velocity=$3";
+        case Event::keyReleased:        return "Key released: keyCode=$1 notes=$2";
+        case Event::midiQueueFull:      return "MIDI event queue full - dropped message $1 $2";
+        case Event::numEvents:
+        default:                        return "Unknown event: $1 $2 $3";
+    }
+}
+
+//==============================================================================
+void TraceLogger::run()
+{
+    while (!threadShouldExit())
+    {
+        wait(100);
+        flushRecords();
+    }
+    
+    flushRecords();
+}
+
+void TraceLogger::flushRecords()
+{
+    ring->drain([this](const Record& record)
+    {
+        const auto seconds = juce::Time::highResolutionTicksToSeconds(record.timestampTicks);
+        
+        writeLine(juce::String(seconds, 6) + " [" + getLevelName(record.level) + "] "
+                  + juce::String(getEventFormat(record.event))
+                        .replace("$1", juce::String(record.args[0]))
+                        .replace("$2", juce::String(record.args[1]))
+                        .replace("$3", juce::String(record.args[2])));
+    });
+    
+    const auto dropped = getNumDroppedRecords();
+    
+    if (dropped != reportedDroppedRecords)
+    {
+        writeLine("Trace ring full - " + juce::String((juce::int64)(dropped - reportedDroppedRecords)) + " records dropped");
+        reportedDroppedRecords = dropped;
+    }
+    
+    if (stream != nullptr)
+        stream->flush();
+}
+
+void TraceLogger::writeLine(const juce::String& line)
+{
+    if (stream != nullptr && stream->getPosition() >= maxFileSizeBytes)
+        rotateFiles();
+    
+    if (stream == nullptr)
+    {
+        const auto file = getLogFile();
+        file.getParentDirectory().createDirectory();
+        
+        stream = std::make_unique<juce::FileOutputStream>(file);
+        
+        if (stream->failedToOpen())
+        {
+            stream.reset();
+            return;
+        }
+    }
+    
+    stream->writeText(line + juce::newLine, false, false, nullptr);
+}
+
+void TraceLogger::rotateFiles()
+{
+    stream.reset();
+    
+    // trace.log -> trace.1.log -> trace.2.log ..., dropping the oldest
+    const auto file = getLogFile();
+    auto getRotatedFile = [&file](int index)
+    {
+        return file.getSiblingFile(file.getFileNameWithoutExtension() + "." + juce::String(index) + file.getFileExtension());
+    };
+    
+    getRotatedFile(numRotatedFiles).deleteFile();
+    
+    for (int index = numRotatedFiles - 1; index >= 1; --index)
+        getRotatedFile(index).moveFileTo(getRotatedFile(index + 1));
+    
+    file.moveFileTo(getRotatedFile(1));
+}
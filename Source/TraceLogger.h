@@ -0,0 +1,120 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MpscRing.h"
+
+/** Set STRADELLA_ENABLE_TRACING=0 in a build's preprocessor definitions to
+    compile every STRADELLA_TRACE call out entirely.
+*/
+#ifndef STRADELLA_ENABLE_TRACING
+ #define STRADELLA_ENABLE_TRACING 1
+#endif
+
+//==============================================================================
+/**
+    Low-overhead tracing for the real-time paths (expression sampling thread,
+    audio thread, key handling).
+    
+    trace() writes a compact fixed-size binary record - timestamp, event id and
+    up to three ints - into a preallocated lock-free ring, without formatting,
+    allocating or touching a file. A background thread turns the records into
+    text and appends them to a log file that is rotated when it gets large.
+    
+    Use the STRADELLA_TRACE macro rather than calling trace() directly, so the
+    calls disappear when tracing is compiled out.
+*/
+class TraceLogger : private juce::Thread,
+                    private juce::DeletedAtShutdown
+{
+public:
+    enum class Level
+    {
+        off,
+        error,
+        info,
+        debug,
+        verbose
+    };
+    
+    /** What happened. Each id has a fixed name and meaning for its arguments (see getEventFormat). */
+    enum class Event : juce::uint16
+    {
+        modulationTarget,       // value
+        expressionTarget,       // value
+        bellowsReversal,        // velocity
+        keyPressed,             // key code, number of notes, velocity
+        keyReleased,            // key code, number of notes
+        midiQueueFull,          // status byte, data byte 1
+        numEvents
+    };
+    
+    static constexpr int ringCapacity = 4096;      // Records, power of two
+    static constexpr juce::int64 maxFileSizeBytes = 1024 * 1024;
+    static constexpr int numRotatedFiles = 3;
+    
+    //==============================================================================
+    ~TraceLogger() override;
+    
+    JUCE_DECLARE_SINGLETON (TraceLogger, false)
+    
+    /** Records an event if the level is enabled. Lock-free and never allocates, any thread. */
+    void trace(Level level, Event event, int arg1 = 0, int arg2 = 0, int arg3 = 0) noexcept;
+    
+    /** Selects which levels are recorded (any thread) */
+    void setLevel(Level newLevel) noexcept   { level.store(newLevel, std::memory_order_relaxed); }
+    Level getLevel() const noexcept          { return level.load(std::memory_order_relaxed); }
+    
+    /** Returns true if events at this level are currently recorded */
+    bool isEnabled(Level eventLevel) const noexcept { return eventLevel != Level::off && eventLevel <= getLevel(); }
+    
+    /** Number of records lost because the ring was full */
+    juce::uint64 getNumDroppedRecords() const noexcept { return ring->getNumDroppedItems(); }
+    
+    /** The current log file; older ones have .1, .2, ... before the extension */
+    static juce::File getLogFile();
+    
+    static juce::String getLevelName(Level levelToName);
+
+private:
+    TraceLogger();
+    
+    struct Record
+    {
+        juce::int64 timestampTicks;
+        std::array<int, 3> args;
+        Event event;
+        Level level;
+    };
+    
+    // Drained by the background thread only
+    std::unique_ptr<MpscRing<Record, ringCapacity>> ring;
+    
+    std::atomic<Level> level { Level::info };
+    juce::uint64 reportedDroppedRecords = 0;
+    
+    std::unique_ptr<juce::FileOutputStream> stream;
+    
+    void run() override;
+    void flushRecords();
+    void writeLine(const juce::String& line);
+    void rotateFiles();
+    
+    static const char* getEventFormat(Event event) noexcept;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TraceLogger)
+};
+
+//==============================================================================
+#if STRADELLA_ENABLE_TRACING
+ /** Records a trace event with one to three int arguments, e.g.
+     STRADELLA_TRACE (debug, keyPressed, keyCode, numNotes, velocity).
+     Never creates the logger, so it is safe on the audio thread.
+ */
+ #define STRADELLA_TRACE(traceLevel, traceEvent, ...) \
+    do { \
+        if (auto* traceLogger = TraceLogger::getInstanceWithoutCreating()) \
+            traceLogger->trace (TraceLogger::Level::traceLevel, TraceLogger::Event::traceEvent, __VA_ARGS__); \
+    } while (false)
+#else
+ #define STRADELLA_TRACE(traceLevel, traceEvent, ...) do {} while (false)
+#endif
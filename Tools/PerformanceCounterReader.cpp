@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Prints the performance counters of running straDellaMIDI instances.
+
+    Every plugin instance publishes its counters in a memory-mapped file in
+    PerformanceCounters::getStatsDirectory(). This tool maps those files
+    read-only, so it can watch a plugin live without touching the host.
+    Files left behind by a crashed instance are skipped.
+
+    Usage: straDellaStats [--watch] [stats file]
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "PerformanceCounters.h"
+
+#include <cstdio>
+
+//==============================================================================
+namespace
+{
+    using Counter = PerformanceCounters::Counter;
+    
+    bool printStatsFile(const juce::File& file)
+    {
+        juce::MemoryMappedFile mappedFile(file, juce::MemoryMappedFile::readOnly);
+        
+        if (!PerformanceCounters::isValidPage(mappedFile.getData(), mappedFile.getSize()))
+        {
+            std::fprintf(stderr, "%s: not a stats file of this version\n", file.getFullPathName().toRawUTF8());
+            return false;
+        }
+        
+        const auto& page = *static_cast<const PerformanceCounters::Page*>(mappedFile.getData());
+        const auto startTime = juce::Time(page.startTimeMillis);
+        
+        std::printf("%s (started %s)\n", file.getFileName().toRawUTF8(),
+                    startTime.toString(true, true, true, true).toRawUTF8());
+        
+        for (int i = 0; i < PerformanceCounters::numCounters; ++i)
+            std::printf("  %-24s %14llu\n", PerformanceCounters::getCounterName((Counter)i),
+                        (unsigned long long)page.counters[(size_t)i].load(std::memory_order_relaxed));
+        
+        return true;
+    }
+    
+    juce::Array<juce::File> findStatsFiles()
+    {
+        auto files = PerformanceCounters::getStatsDirectory().findChildFiles(juce::File::findFiles, false, "*.stats");
+        files.removeIf([](const juce::File& file) { return !PerformanceCounters::isStatsFileInUse(file); });
+        files.sort();
+        return files;
+    }
+}
+
+//==============================================================================
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    
+    juce::StringArray args(argv + 1, argc - 1);
+    const bool watch = args.contains("--watch");
+    args.removeString("--watch");
+    
+    for (;;)
+    {
+        const auto files = args.isEmpty() ? findStatsFiles()
+                                          : juce::Array<juce::File> { juce::File::getCurrentWorkingDirectory().getChildFile(args[0]) };
+        
+        if (files.isEmpty())
+            std::printf("No running instances (%s)\n", PerformanceCounters::getStatsDirectory().getFullPathName().toRawUTF8());
+        
+        bool allValid = true;
+        
+        for (const auto& file : files)
+            allValid = printStatsFile(file) && allValid;
+        
+        if (!watch)
+            return allValid ? 0 : 1;
+        
+        std::printf("\n");
+        std::fflush(stdout);
+        juce::Thread::sleep(1000);
+    }
+}